@@ -1,21 +1,134 @@
 #include "SCIAsyncSaveImageTask.h"
 #include "../VLog.h"
 #include <Misc/FileHelper.h>
+#include <Misc/QueuedThreadPool.h>
 
-FSCIAsyncSaveImageTask::FSCIAsyncSaveImageTask( const TArray64<uint8>& InImage, const FString& InImageName )
+FSCIAsyncSaveImageTask::FSCIAsyncSaveImageTask( TArray64<uint8>&& InImage, const FString& InImageName, FSCIImageWriterPool* InOwner, int64 InFrameId )
+: Image( MoveTemp( InImage ) ), Filename( InImageName ), Owner( InOwner ), FrameId( InFrameId )
 {
-    Image    = InImage;
-    Filename = InImageName;
 }
 
 void FSCIAsyncSaveImageTask::DoWork()
 {
-    VLOG( Log, TEXT( "Starting save file." ) );
-    FFileHelper::SaveArrayToFile( Image, *Filename );
-    VLOG( Log, TEXT( "Stored Image: %s" ), *Filename );
+    auto isWritten = false;
+    if ( (Owner != nullptr) && (Owner->Container != nullptr) ) {
+        isWritten = Owner->Container->Append( FrameId, Filename, Image );
+        if ( isWritten ) {
+            VLOG( Log, TEXT( "Archived Image: %s" ), *Filename );
+        }
+        else {
+            // A frame the container refused is still kept, as a loose file next to it.
+            VLOG( Error, TEXT( "Failed to archive %s, falling back to a separate file." ), *Filename );
+        }
+    }
+
+    if ( !isWritten ) {
+        VLOG( Log, TEXT( "Starting save file." ) );
+        if ( FFileHelper::SaveArrayToFile( Image, *Filename ) ) {
+            VLOG( Log, TEXT( "Stored Image: %s" ), *Filename );
+        }
+        else {
+            VLOG( Error, TEXT( "Failed to store image: %s" ), *Filename );
+        }
+    }
+
+    if ( Owner != nullptr )
+        Owner->OnWriteFinished();
 }
 
 TStatId FSCIAsyncSaveImageTask::GetStatId() const
 {
     RETURN_QUICK_DECLARE_CYCLE_STAT( FSCIAsyncSaveImageTask, STATGROUP_ThreadPoolAsyncTasks );
 }
+
+//-----------------------------------------------------------------------------
+
+FSCIImageWriterPool::FSCIImageWriterPool()
+{
+    ThreadPool  = nullptr;
+    Container   = nullptr;
+    QueuedCount = 0;
+    MaxQueued   = 0;
+}
+
+FSCIImageWriterPool::~FSCIImageWriterPool()
+{
+    Release();
+}
+
+void FSCIImageWriterPool::Initialize( int32 InThreadCount, int32 InMaxQueued, ISCIFrameContainer* InContainer, const FSCIUringFileWriter::FOptions* InWriteBehind )
+{
+    Release();
+
+    MaxQueued = FMath::Max( InMaxQueued, 1 );
+    Container = InContainer;
+
+    // Containers append from the pool threads, write-behind only takes whole files. The pool never
+    // queues more than MaxQueued files, so a deeper ring would only hold unused entries.
+    if ( (InWriteBehind != nullptr) && (Container == nullptr) ) {
+        auto writeBehind = *InWriteBehind;
+        if ( writeBehind.QueueDepth > MaxQueued ) {
+            VLOG( Warning, TEXT( "Write-behind queue depth %d is limited to the %d queued writes." ), writeBehind.QueueDepth, MaxQueued );
+            writeBehind.QueueDepth = MaxQueued;
+        }
+        WriteBehind.Initialize( writeBehind );
+    }
+
+    ThreadPool = FQueuedThreadPool::Allocate();
+    ThreadPool->Create( FMath::Max( InThreadCount, 1 ), 64 * 1024, TPri_BelowNormal, TEXT( "SCIWriterPool" ) );
+}
+
+void FSCIImageWriterPool::Release()
+{
+    if ( ThreadPool == nullptr )
+        return;
+
+    // Flush every pending write before the threads go away.
+    while ( QueuedCount.Load() > 0 )
+        FPlatformProcess::Sleep( 0.001f );
+
+    ThreadPool->Destroy();
+    delete ThreadPool;
+    ThreadPool = nullptr;
+    WriteBehind.Release();
+}
+
+ESCISubmitResult FSCIImageWriterPool::TrySubmit( TArray64<uint8>&& InImage, const FString& InImageName, int64 InFrameId )
+{
+    if ( (ThreadPool == nullptr) || !TryReserveSlot() )
+        return ESCISubmitResult::WouldBlock;
+
+    if ( WriteBehind.IsAvailable() ) {
+        WriteBehind.Write( MoveTemp( InImage ), InImageName, [this]( bool ){ OnWriteFinished(); } );
+        return ESCISubmitResult::Accepted;
+    }
+
+    (new FAutoDeleteAsyncTask<FSCIAsyncSaveImageTask>( MoveTemp( InImage ), InImageName, this, InFrameId ))->StartBackgroundTask( ThreadPool );
+    return ESCISubmitResult::Accepted;
+}
+
+bool FSCIImageWriterPool::IsSaturated() const
+{
+    return QueuedCount.Load() >= MaxQueued;
+}
+
+int32 FSCIImageWriterPool::GetQueuedCount() const
+{
+    return QueuedCount.Load();
+}
+
+bool FSCIImageWriterPool::TryReserveSlot()
+{
+    // Encoder threads submit concurrently, the bound only holds if check and increment are one step.
+    auto queuedCount = QueuedCount.Load();
+    while ( queuedCount < MaxQueued ) {
+        if ( QueuedCount.CompareExchange( queuedCount, queuedCount + 1 ) )
+            return true;
+    }
+    return false;
+}
+
+void FSCIImageWriterPool::OnWriteFinished()
+{
+    QueuedCount--;
+}
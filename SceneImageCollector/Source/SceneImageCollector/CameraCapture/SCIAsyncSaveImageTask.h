@@ -1,12 +1,33 @@
 // Copyright Devcoder.
 #pragma once
+#include "SCIUringFileWriter.h"
 #include <CoreMinimal.h>
 #include <Async/AsyncWork.h>
 
+enum class ESCISubmitResult : uint8
+{
+    Accepted,
+    WouldBlock
+};
+
+//-----------------------------------------------------------------------------
+
+// Packs written images into a few large files instead of one file per image.
+class ISCIFrameContainer
+{
+public:
+    virtual ~ISCIFrameContainer() = default;
+
+    // Called from every writer thread at once.
+    virtual bool Append( int64 InFrameId, const FString& InName, const TArray64<uint8>& InData ) = 0;
+};
+
+//-----------------------------------------------------------------------------
+
 class FSCIAsyncSaveImageTask : public FNonAbandonableTask
 {
 public:
-    FSCIAsyncSaveImageTask( const TArray64<uint8>& InImage, const FString& InImageName );
+    FSCIAsyncSaveImageTask( TArray64<uint8>&& InImage, const FString& InImageName, class FSCIImageWriterPool* InOwner = nullptr, int64 InFrameId = INDEX_NONE );
 
     void DoWork();
     TStatId GetStatId() const;
@@ -14,4 +35,38 @@ public:
 protected:
     TArray64<uint8> Image;
     FString Filename;
+    class FSCIImageWriterPool* Owner;
+    int64 FrameId;
+};
+
+//-----------------------------------------------------------------------------
+
+// Dedicated, sized thread pool for SCI file I/O with a bounded submission queue.
+// A full queue rejects the write with WouldBlock and leaves the payload with the caller.
+// With a container set, images are appended to it instead of being written as files.
+// With write-behind, plain files skip the threads and go to the io_uring writer.
+class FSCIImageWriterPool
+{
+    friend class FSCIAsyncSaveImageTask;
+public:
+    FSCIImageWriterPool();
+    ~FSCIImageWriterPool();
+
+    void Initialize( int32 InThreadCount, int32 InMaxQueued, ISCIFrameContainer* InContainer = nullptr, const FSCIUringFileWriter::FOptions* InWriteBehind = nullptr );
+    void Release();
+
+    ESCISubmitResult TrySubmit( TArray64<uint8>&& InImage, const FString& InImageName, int64 InFrameId = INDEX_NONE );
+    bool IsSaturated() const;
+    int32 GetQueuedCount() const;
+
+private:
+    bool TryReserveSlot();
+    void OnWriteFinished();
+
+private:
+    FQueuedThreadPool* ThreadPool;
+    ISCIFrameContainer* Container;
+    FSCIUringFileWriter WriteBehind;
+    TAtomic<int32> QueuedCount;
+    int32 MaxQueued;
 };
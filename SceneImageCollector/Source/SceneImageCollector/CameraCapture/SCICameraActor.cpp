@@ -9,11 +9,18 @@
 ASCICameraActor::ASCICameraActor( const FObjectInitializer& ObjectInitializer )
 : Super( ObjectInitializer )
 {
+    PrimaryActorTick.bCanEverTick = true;
+
     FollowerComponent = CreateDefaultSubobject<USCIFollowerComponent>( TEXT( "PathFollowerComp" ) );
     AddOwnedComponent( FollowerComponent );
 
     PathIndex = 0;
     IsLoop    = false;
+
+    IsPauseOnBackpressure  = true;
+    InFlightHighWatermark  = 24;
+    InFlightLowWatermark   = 8;
+    IsPausedByBackpressure = false;
 }
 
 void ASCICameraActor::BeginPlay()
@@ -59,6 +66,36 @@ void ASCICameraActor::OnEventAction( USCIFollowerComponent*, float, UObject* )
     if ( CaptureActor.IsValid() ) {
         VLOG( Log, TEXT( "Scene Captured." ) );
         CaptureActor->Capture();
+        UpdateCaptureBackpressure();
+    }
+}
+
+void ASCICameraActor::Tick( float InDeltaTime )
+{
+    Super::Tick( InDeltaTime );
+
+    UpdateCaptureBackpressure();
+}
+
+void ASCICameraActor::UpdateCaptureBackpressure()
+{
+    if ( !IsPauseOnBackpressure || !CaptureActor.IsValid() )
+        return;
+
+    // Hysteresis between the watermarks keeps the follower from toggling every frame.
+    const auto inFlightCount = CaptureActor->GetInFlightFrameCount();
+    if ( !IsPausedByBackpressure ) {
+        if ( (inFlightCount >= InFlightHighWatermark) && FollowerComponent->IsStarted && !FollowerComponent->IsPause ) {
+            VLOG( Log, TEXT( "Capture pipeline saturated, pausing follower. (In flight: %d)" ), inFlightCount );
+            FollowerComponent->Pause();
+            IsPausedByBackpressure = true;
+        }
+    }
+    else if ( inFlightCount <= FMath::Min( InFlightLowWatermark, InFlightHighWatermark - 1 ) ) {
+        VLOG( Log, TEXT( "Capture pipeline drained, resuming follower. (In flight: %d)" ), inFlightCount );
+        IsPausedByBackpressure = false;
+        if ( FollowerComponent->IsStarted && FollowerComponent->IsPause )
+            FollowerComponent->Start();
     }
 }
 
@@ -8,6 +8,9 @@ UCLASS()
 class ASCICameraActor : public ACameraActor
 {
     GENERATED_UCLASS_BODY()
+public:
+    virtual void Tick( float InDeltaTime ) override;
+
 protected:
     virtual void BeginPlay() override;
 
@@ -19,6 +22,8 @@ protected:
     bool IsValidPathsIndex() const;
     int32 UpdatePathIndex();
 
+    void UpdateCaptureBackpressure();
+
 protected:
     UPROPERTY( VisibleAnywhere, BlueprintReadOnly, Category=Follower )
     TObjectPtr<class USCIFollowerComponent> FollowerComponent;
@@ -26,7 +31,15 @@ protected:
     UPROPERTY( EditAnywhere, BlueprintReadOnly, Category=Path )
     TArray<TObjectPtr<class AActor>> PathActors;
 
+    UPROPERTY( EditAnywhere, BlueprintReadOnly, Category=Capture )
+    bool IsPauseOnBackpressure;
+    UPROPERTY( EditAnywhere, BlueprintReadOnly, Category=Capture, meta=(EditCondition="IsPauseOnBackpressure", ClampMin=1, UIMin=1) )
+    int32 InFlightHighWatermark;
+    UPROPERTY( EditAnywhere, BlueprintReadOnly, Category=Capture, meta=(EditCondition="IsPauseOnBackpressure", ClampMin=0, UIMin=0) )
+    int32 InFlightLowWatermark;
+
     TWeakObjectPtr<class ASCISceneCaptureActor> CaptureActor;
     int32 PathIndex;
     bool IsLoop;
+    bool IsPausedByBackpressure;
 };
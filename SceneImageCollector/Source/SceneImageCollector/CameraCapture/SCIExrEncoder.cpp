@@ -0,0 +1,227 @@
+#include "SCIExrEncoder.h"
+#include "../VLog.h"
+#include <Async/ParallelFor.h>
+THIRD_PARTY_INCLUDES_START
+#include <zlib.h>
+THIRD_PARTY_INCLUDES_END
+
+namespace SCI
+{
+    constexpr int32 EXR_ZIP_BLOCK_LINES = 16;
+    constexpr uint8 EXR_NO_COMPRESSION  = 0;
+    constexpr uint8 EXR_ZIP_COMPRESSION = 3;
+    constexpr int32 EXR_PIXEL_TYPE_HALF  = 1;
+    constexpr int32 EXR_PIXEL_TYPE_FLOAT = 2;
+
+    struct FExrBlock
+    {
+        int32 FirstLine = 0;
+        int32 LineCount = 0;
+        TArray64<uint8> Data;
+        bool IsSucceeded = false;
+    };
+
+    // EXR is little-endian throughout.
+    template<typename T>
+    void ExrWrite( TArray64<uint8>& OutData, T InValue )
+    {
+        static_assert( PLATFORM_LITTLE_ENDIAN, "EXR writer expects a little-endian host." );
+        OutData.Append( reinterpret_cast<const uint8*>( &InValue ), sizeof( T ) );
+    }
+
+    void ExrWriteString( TArray64<uint8>& OutData, const ANSICHAR* InString )
+    {
+        OutData.Append( reinterpret_cast<const uint8*>( InString ), FCStringAnsi::Strlen( InString ) + 1 );
+    }
+
+    void ExrWriteAttribute( TArray64<uint8>& OutData, const ANSICHAR* InName, const ANSICHAR* InType, int32 InSize )
+    {
+        ExrWriteString( OutData, InName );
+        ExrWriteString( OutData, InType );
+        ExrWrite<int32>( OutData, InSize );
+    }
+
+    void ExrWriteBox( TArray64<uint8>& OutData, const ANSICHAR* InName, const FIntPoint& InResolution )
+    {
+        ExrWriteAttribute( OutData, InName, "box2i", 16 );
+        ExrWrite<int32>( OutData, 0 );
+        ExrWrite<int32>( OutData, 0 );
+        ExrWrite<int32>( OutData, InResolution.X - 1 );
+        ExrWrite<int32>( OutData, InResolution.Y - 1 );
+    }
+
+    void ExrWriteHeader( TArray64<uint8>& OutData, const TArray<FSCIExrEncoder::FChannel>& InChannels, const FIntPoint& InResolution, uint8 InCompression )
+    {
+        // Magic number and version 2, single-part scanline.
+        ExrWrite<uint32>( OutData, 20000630 );
+        ExrWrite<uint32>( OutData, 2 );
+
+        int32 channelListSize = 1;
+        for ( const auto& channel : InChannels )
+            channelListSize += FCStringAnsi::Strlen( channel.Name ) + 1 + 16;
+
+        ExrWriteAttribute( OutData, "channels", "chlist", channelListSize );
+        for ( const auto& channel : InChannels ) {
+            ExrWriteString( OutData, channel.Name );
+            ExrWrite<int32>( OutData, channel.IsFloat ? EXR_PIXEL_TYPE_FLOAT : EXR_PIXEL_TYPE_HALF );
+            ExrWrite<uint32>( OutData, 0 );     // pLinear and reserved
+            ExrWrite<int32>( OutData, 1 );      // xSampling
+            ExrWrite<int32>( OutData, 1 );      // ySampling
+        }
+        OutData.Add( 0 );
+
+        ExrWriteAttribute( OutData, "compression", "compression", 1 );
+        OutData.Add( InCompression );
+        ExrWriteBox( OutData, "dataWindow", InResolution );
+        ExrWriteBox( OutData, "displayWindow", InResolution );
+        ExrWriteAttribute( OutData, "lineOrder", "lineOrder", 1 );
+        OutData.Add( 0 );
+        ExrWriteAttribute( OutData, "pixelAspectRatio", "float", 4 );
+        ExrWrite<float>( OutData, 1.0f );
+        ExrWriteAttribute( OutData, "screenWindowCenter", "v2f", 8 );
+        ExrWrite<float>( OutData, 0.0f );
+        ExrWrite<float>( OutData, 0.0f );
+        ExrWriteAttribute( OutData, "screenWindowWidth", "float", 4 );
+        ExrWrite<float>( OutData, 1.0f );
+        OutData.Add( 0 );
+    }
+
+    template<typename T>
+    T* ExrGatherLine( const FSCIExrEncoder::FChannel& InChannel, int32 InWidth, int32 InLine, T* OutData )
+    {
+        auto source = static_cast<const T*>( InChannel.Data ) + (int64)InLine * InWidth * InChannel.Stride;
+        for ( int32 x = 0; x < InWidth; x++, source += InChannel.Stride )
+            *OutData++ = *source;
+        return OutData;
+    }
+
+    // Lines of the block, each line holding all channels one after another in channel order.
+    void ExrGatherBlock( const TArray<FSCIExrEncoder::FChannel>& InChannels, const FIntPoint& InResolution, int32 InFirstLine, int32 InLineCount, uint8* OutData )
+    {
+        for ( int32 line = InFirstLine; line < InFirstLine + InLineCount; line++ ) {
+            for ( const auto& channel : InChannels ) {
+                if ( channel.IsFloat )
+                    OutData = reinterpret_cast<uint8*>( ExrGatherLine( channel, InResolution.X, line, reinterpret_cast<uint32*>( OutData ) ) );
+                else
+                    OutData = reinterpret_cast<uint8*>( ExrGatherLine( channel, InResolution.X, line, reinterpret_cast<uint16*>( OutData ) ) );
+            }
+        }
+    }
+
+    bool ExrCompressBlock( const TArray<FSCIExrEncoder::FChannel>& InChannels, const FIntPoint& InResolution, int32 InCompressionLevel, FExrBlock& InOutBlock )
+    {
+        int64 lineSize = 0;
+        for ( const auto& channel : InChannels )
+            lineSize += (int64)InResolution.X * channel.GetSampleSize();
+
+        const auto rawSize = lineSize * InOutBlock.LineCount;
+        TArray64<uint8> raw;
+        raw.SetNumUninitialized( rawSize );
+        ExrGatherBlock( InChannels, InResolution, InOutBlock.FirstLine, InOutBlock.LineCount, raw.GetData() );
+
+        if ( InCompressionLevel <= 0 ) {
+            InOutBlock.Data = MoveTemp( raw );
+            return true;
+        }
+
+        // Split low and high bytes into two halves, then delta encode, as the ZIP codec expects.
+        TArray64<uint8> reordered;
+        reordered.SetNumUninitialized( rawSize );
+        const auto half = (rawSize + 1) / 2;
+        for ( int64 i = 0; i < rawSize; i++ )
+            reordered[ (i & 1) ? (half + (i >> 1)) : (i >> 1) ] = raw[ i ];
+
+        for ( int64 i = rawSize - 1; i > 0; i-- )
+            reordered[ i ] = (uint8)(reordered[ i ] - reordered[ i - 1 ] + 128);
+
+        auto compressedSize = compressBound( (uLong)rawSize );
+        InOutBlock.Data.SetNumUninitialized( compressedSize );
+        if ( compress2( InOutBlock.Data.GetData(), &compressedSize, reordered.GetData(), (uLong)rawSize, InCompressionLevel ) != Z_OK )
+            return false;
+
+        // Readers treat a block whose size equals the raw size as uncompressed.
+        if ( (int64)compressedSize >= rawSize )
+            InOutBlock.Data = MoveTemp( raw );
+        else
+            InOutBlock.Data.SetNum( compressedSize, false );
+
+        return true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool FSCIExrEncoder::Encode( TArray<FChannel> InChannels, const FIntPoint& InResolution, int32 InCompressionLevel, TArray64<uint8>& OutExr )
+{
+    if ( InChannels.IsEmpty() || (InResolution.X <= 0) || (InResolution.Y <= 0) )
+        return false;
+
+    for ( const auto& channel : InChannels ) {
+        if ( (channel.Name == nullptr) || (channel.Data == nullptr) )
+            return false;
+    }
+
+    // Channels are stored in alphabetical order.
+    InChannels.Sort( []( const FChannel& InA, const FChannel& InB ){ return FCStringAnsi::Strcmp( InA.Name, InB.Name ) < 0; } );
+
+    const auto compressionLevel = FMath::Clamp( InCompressionLevel, 0, 9 );
+    const auto linesPerBlock    = compressionLevel > 0 ? SCI::EXR_ZIP_BLOCK_LINES : 1;
+    const auto blockCount       = FMath::DivideAndRoundUp( InResolution.Y, linesPerBlock );
+
+    TArray<SCI::FExrBlock> blocks;
+    blocks.SetNum( blockCount );
+    ParallelFor( blockCount, [&]( int32 InIndex ){
+        auto& block = blocks[ InIndex ];
+        block.FirstLine   = InIndex * linesPerBlock;
+        block.LineCount   = FMath::Min( linesPerBlock, InResolution.Y - block.FirstLine );
+        block.IsSucceeded = SCI::ExrCompressBlock( InChannels, InResolution, compressionLevel, block );
+    });
+
+    int64 payloadSize = 0;
+    for ( const auto& block : blocks ) {
+        if ( !block.IsSucceeded ) {
+            VLOG( Error, TEXT( "Failed to compress exr block at line %d." ), block.FirstLine );
+            return false;
+        }
+        payloadSize += block.Data.Num() + 8;
+    }
+
+    OutExr.Reset( payloadSize + blockCount * 8 + 512 );
+    SCI::ExrWriteHeader( OutExr, InChannels, InResolution, compressionLevel > 0 ? SCI::EXR_ZIP_COMPRESSION : SCI::EXR_NO_COMPRESSION );
+
+    // Offset table, then every block prefixed with its first line and size.
+    auto offset = (uint64)(OutExr.Num() + blockCount * 8);
+    for ( const auto& block : blocks ) {
+        SCI::ExrWrite<uint64>( OutExr, offset );
+        offset += block.Data.Num() + 8;
+    }
+
+    for ( const auto& block : blocks ) {
+        SCI::ExrWrite<int32>( OutExr, block.FirstLine );
+        SCI::ExrWrite<int32>( OutExr, (int32)block.Data.Num() );
+        OutExr.Append( block.Data );
+    }
+
+    return true;
+}
+
+void FSCIExrEncoder::GetColorChannels( const FFloat16Color* InPixels, bool InIsWithAlpha, TArray<FChannel>& OutChannels )
+{
+    OutChannels.Add( { "R", &InPixels->R, 4 } );
+    OutChannels.Add( { "G", &InPixels->G, 4 } );
+    OutChannels.Add( { "B", &InPixels->B, 4 } );
+    if ( InIsWithAlpha )
+        OutChannels.Add( { "A", &InPixels->A, 4 } );
+}
+
+void FSCIExrEncoder::GetLayerChannels( const float* InDepth, const FFloat16Color* InNormal, TArray<FChannel>& OutChannels )
+{
+    if ( InDepth != nullptr )
+        OutChannels.Add( { "Z", InDepth, 1, true } );
+
+    if ( InNormal != nullptr ) {
+        OutChannels.Add( { "N.X", &InNormal->R, 4 } );
+        OutChannels.Add( { "N.Y", &InNormal->G, 4 } );
+        OutChannels.Add( { "N.Z", &InNormal->B, 4 } );
+    }
+}
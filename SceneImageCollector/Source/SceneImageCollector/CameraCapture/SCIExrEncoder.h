@@ -0,0 +1,27 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+
+// Single-part scanline OpenEXR writer for half-float and float channels. Blocks of 16 lines
+// are ZIP compressed in parallel; a block that does not shrink is stored raw.
+class FSCIExrEncoder
+{
+public:
+    struct FChannel
+    {
+        const ANSICHAR* Name = nullptr;
+        // First sample and the distance between two samples, in samples.
+        const void* Data = nullptr;
+        int32 Stride = 1;
+        // 32-bit float samples instead of halves.
+        bool IsFloat = false;
+
+        int32 GetSampleSize() const { return IsFloat ? sizeof( float ) : sizeof( FFloat16 ); }
+    };
+
+    // A compression level of 0 writes uncompressed scanlines.
+    static bool Encode( TArray<FChannel> InChannels, const FIntPoint& InResolution, int32 InCompressionLevel, TArray64<uint8>& OutExr );
+    static void GetColorChannels( const FFloat16Color* InPixels, bool InIsWithAlpha, TArray<FChannel>& OutChannels );
+    // Depth is a full float Z channel, normals come from rgb; null layers are skipped.
+    static void GetLayerChannels( const float* InDepth, const FFloat16Color* InNormal, TArray<FChannel>& OutChannels );
+};
@@ -0,0 +1,356 @@
+#include "SCIFrameArchive.h"
+#include "../VLog.h"
+#include <Async/MappedFileHandle.h>
+#include <HAL/IConsoleManager.h>
+#include <HAL/PlatformFileManager.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+#include <Misc/ScopeLock.h>
+
+FString FSCIFrameArchive::GetIndexFilename( const FString& InBaseFilename )
+{
+    return InBaseFilename + TEXT( ".sciidx" );
+}
+
+FString FSCIFrameArchive::GetSegmentFilename( const FString& InBaseFilename, int32 InSegment )
+{
+    return FString::Printf( TEXT( "%s_%05d.scia" ), *InBaseFilename, InSegment );
+}
+
+//-----------------------------------------------------------------------------
+
+FSCIFrameArchiveWriter::FSCIFrameArchiveWriter()
+{
+    SegmentSize   = 0;
+    SegmentIndex  = INDEX_NONE;
+    SegmentOffset = 0;
+    RecordCount   = 0;
+    WrittenSize   = 0;
+}
+
+FSCIFrameArchiveWriter::~FSCIFrameArchiveWriter()
+{
+    Close();
+}
+
+bool FSCIFrameArchiveWriter::Open( const FString& InBaseFilename, const FString& InRootDirectory, int64 InSegmentSize )
+{
+    Close();
+
+    auto& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+    platformFile.CreateDirectoryTree( *FPaths::GetPath( InBaseFilename ) );
+
+    FScopeLock lock( &Mutex );
+    Index.Reset( platformFile.OpenWrite( *FSCIFrameArchive::GetIndexFilename( InBaseFilename ) ) );
+    if ( !Index.IsValid() ) {
+        VLOG( Error, TEXT( "Failed to create frame archive: %s" ), *InBaseFilename );
+        return false;
+    }
+
+    BaseFilename  = InBaseFilename;
+    RootDirectory = InRootDirectory;
+    SegmentSize   = Align( FMath::Max( InSegmentSize, FSCIFrameArchive::ALIGNMENT * 2 ), FSCIFrameArchive::ALIGNMENT );
+    SegmentIndex  = INDEX_NONE;
+    SegmentOffset = 0;
+    RecordCount   = 0;
+    WrittenSize   = 0;
+
+    FSCIFrameArchive::FIndexHeader header;
+    header.SegmentSize = SegmentSize;
+    Index->Write( reinterpret_cast<const uint8*>( &header ), sizeof( header ) );
+
+    VLOG( Display, TEXT( "Frame archive opened: %s (Segment: %lld MB)" ), *BaseFilename, SegmentSize >> 20 );
+    return true;
+}
+
+void FSCIFrameArchiveWriter::Close()
+{
+    FScopeLock lock( &Mutex );
+    if ( !Index.IsValid() )
+        return;
+
+    CloseSegment();
+    Index->Flush();
+    Index.Reset();
+
+    VLOG( Display, TEXT( "Frame archive closed: %s (Records: %d, %.1f MB in %d segments)" )
+    , *BaseFilename, RecordCount, WrittenSize / (1024.0 * 1024.0), SegmentIndex + 1 );
+}
+
+bool FSCIFrameArchiveWriter::IsOpen() const
+{
+    FScopeLock lock( &Mutex );
+    return Index.IsValid();
+}
+
+bool FSCIFrameArchiveWriter::Append( int64 InFrameId, const FString& InName, const TArray64<uint8>& InData )
+{
+    // Open() replaces the root directory under the lock, so it is copied under it too.
+    FString rootDirectory;
+    {
+        FScopeLock lock( &Mutex );
+        rootDirectory = RootDirectory;
+    }
+
+    auto name = InName;
+    FPaths::MakePathRelativeTo( name, *rootDirectory );
+    const FTCHARToUTF8 utf8Name( *name );
+
+    // Header and name fill the first aligned block, the payload starts on the next boundary.
+    FSCIFrameArchive::FRecordHeader record;
+    record.NameSize = utf8Name.Length();
+    record.Size     = InData.Num();
+    const auto headerSize = Align( (int64)sizeof( record ) + record.NameSize, FSCIFrameArchive::ALIGNMENT );
+    const auto recordSize = headerSize + Align( record.Size, FSCIFrameArchive::ALIGNMENT );
+
+    TArray<uint8> header;
+    header.SetNumZeroed( (int32)headerSize );
+    FMemory::Memcpy( header.GetData(), &record, sizeof( record ) );
+    FMemory::Memcpy( header.GetData() + sizeof( record ), utf8Name.Get(), record.NameSize );
+
+    // One sequential stream per segment, so writers take turns instead of seeking against each other.
+    FScopeLock lock( &Mutex );
+    if ( !Index.IsValid() )
+        return false;
+
+    if ( !Segment.IsValid() || (SegmentOffset + recordSize > SegmentSize) ) {
+        if ( !OpenSegment( FSCIFrameArchive::ALIGNMENT + recordSize ) )
+            return false;
+    }
+
+    auto isWritten = Segment->Seek( SegmentOffset )
+    && Segment->Write( header.GetData(), header.Num() )
+    && Segment->Write( InData.GetData(), InData.Num() );
+    if ( !isWritten ) {
+        VLOG( Error, TEXT( "Failed to append to frame archive: %s" ), *name );
+        return false;
+    }
+
+    // The entry goes in last, a reader never sees a record whose payload was not written.
+    FSCIFrameArchive::FEntry entry;
+    entry.FrameId    = InFrameId;
+    entry.Offset     = SegmentOffset + headerSize;
+    entry.Size       = record.Size;
+    entry.Segment    = (uint32)SegmentIndex;
+    entry.HeaderSize = (uint32)headerSize;
+    isWritten = Index->Write( reinterpret_cast<const uint8*>( &entry ), sizeof( entry ) );
+
+    SegmentOffset += recordSize;
+    WrittenSize   += record.Size;
+    RecordCount++;
+    return isWritten;
+}
+
+int32 FSCIFrameArchiveWriter::GetRecordCount() const
+{
+    FScopeLock lock( &Mutex );
+    return RecordCount;
+}
+
+int64 FSCIFrameArchiveWriter::GetWrittenSize() const
+{
+    FScopeLock lock( &Mutex );
+    return WrittenSize;
+}
+
+bool FSCIFrameArchiveWriter::OpenSegment( int64 InMinimumSize )
+{
+    CloseSegment();
+
+    SegmentIndex++;
+    const auto filename = FSCIFrameArchive::GetSegmentFilename( BaseFilename, SegmentIndex );
+    Segment.Reset( FPlatformFileManager::Get().GetPlatformFile().OpenWrite( *filename ) );
+    if ( !Segment.IsValid() ) {
+        VLOG( Error, TEXT( "Failed to create frame archive segment: %s" ), *filename );
+        return false;
+    }
+
+    // The whole segment is reserved up front, a frame larger than a segment gets one of its own.
+    Segment->Truncate( FMath::Max( SegmentSize, InMinimumSize ) );
+
+    FSCIFrameArchive::FSegmentHeader header;
+    header.Segment = (uint32)SegmentIndex;
+    Segment->Write( reinterpret_cast<const uint8*>( &header ), sizeof( header ) );
+    SegmentOffset = FSCIFrameArchive::ALIGNMENT;
+    return true;
+}
+
+void FSCIFrameArchiveWriter::CloseSegment()
+{
+    if ( !Segment.IsValid() )
+        return;
+
+    // Give back the reserved space nothing was written to.
+    Segment->Truncate( SegmentOffset );
+    Segment->Flush();
+    Segment.Reset();
+}
+
+//-----------------------------------------------------------------------------
+
+FSCIFrameArchiveReader::FSCIFrameArchiveReader()
+{
+}
+
+FSCIFrameArchiveReader::~FSCIFrameArchiveReader()
+{
+    Close();
+}
+
+bool FSCIFrameArchiveReader::Open( const FString& InBaseFilename )
+{
+    Close();
+
+    TArray<uint8> indexData;
+    const auto indexFilename = FSCIFrameArchive::GetIndexFilename( InBaseFilename );
+    if ( !FFileHelper::LoadFileToArray( indexData, *indexFilename ) || (indexData.Num() < (int32)sizeof( FSCIFrameArchive::FIndexHeader )) ) {
+        VLOG( Error, TEXT( "Failed to read frame archive index: %s" ), *indexFilename );
+        return false;
+    }
+
+    FSCIFrameArchive::FIndexHeader header;
+    FMemory::Memcpy( &header, indexData.GetData(), sizeof( header ) );
+    if ( (FMemory::Memcmp( header.Magic, FSCIFrameArchive::FIndexHeader().Magic, 4 ) != 0) || (header.EntrySize != sizeof( FSCIFrameArchive::FEntry )) ) {
+        VLOG( Error, TEXT( "Not a frame archive index: %s" ), *indexFilename );
+        return false;
+    }
+
+    // A partly written last entry from an interrupted run is ignored.
+    const auto entryCount = (indexData.Num() - (int32)sizeof( header )) / (int32)sizeof( FSCIFrameArchive::FEntry );
+    Entries.SetNumUninitialized( entryCount );
+    FMemory::Memcpy( Entries.GetData(), indexData.GetData() + sizeof( header ), entryCount * sizeof( FSCIFrameArchive::FEntry ) );
+
+    uint32 segmentCount = 0;
+    for ( int32 i = 0; i < Entries.Num(); i++ ) {
+        segmentCount = FMath::Max( segmentCount, Entries[ i ].Segment + 1 );
+        FrameRecords.Add( Entries[ i ].FrameId, i );
+    }
+
+    auto& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+    Segments.SetNum( segmentCount );
+    for ( uint32 i = 0; i < segmentCount; i++ ) {
+        const auto filename = FSCIFrameArchive::GetSegmentFilename( InBaseFilename, i );
+        auto& segment = Segments[ i ];
+        segment.File.Reset( platformFile.OpenMapped( *filename ) );
+        if ( segment.File.IsValid() )
+            segment.Region.Reset( segment.File->MapRegion( 0, segment.File->GetFileSize() ) );
+
+        if ( !segment.Region.IsValid() ) {
+            VLOG( Error, TEXT( "Failed to map frame archive segment: %s" ), *filename );
+            Close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FSCIFrameArchiveReader::Close()
+{
+    // Regions have to be unmapped before their files are closed.
+    for ( auto& segment : Segments )
+        segment.Region.Reset();
+
+    Segments.Empty();
+    Entries.Empty();
+    FrameRecords.Empty();
+}
+
+int32 FSCIFrameArchiveReader::GetRecordCount() const
+{
+    return Entries.Num();
+}
+
+const FSCIFrameArchive::FEntry& FSCIFrameArchiveReader::GetEntry( int32 InIndex ) const
+{
+    return Entries[ InIndex ];
+}
+
+int32 FSCIFrameArchiveReader::FindRecord( int64 InFrameId, const FString& InName ) const
+{
+    auto result = INDEX_NONE;
+    for ( auto iter = FrameRecords.CreateConstKeyIterator( InFrameId ); iter; ++iter ) {
+        const auto index = iter.Value();
+        if ( (result != INDEX_NONE) && (index > result) )
+            continue;
+        if ( InName.IsEmpty() || (GetName( index ) == InName) )
+            result = index;
+    }
+
+    return result;
+}
+
+FString FSCIFrameArchiveReader::GetName( int32 InIndex ) const
+{
+    const auto& entry = Entries[ InIndex ];
+    const auto data = GetSegmentData( entry.Segment, entry.Offset - entry.HeaderSize, entry.HeaderSize );
+    if ( data == nullptr )
+        return FString();
+
+    FSCIFrameArchive::FRecordHeader record;
+    FMemory::Memcpy( &record, data, sizeof( record ) );
+    if ( (FMemory::Memcmp( record.Magic, FSCIFrameArchive::FRecordHeader().Magic, 4 ) != 0) || (sizeof( record ) + record.NameSize > entry.HeaderSize) )
+        return FString();
+
+    const FUTF8ToTCHAR name( reinterpret_cast<const ANSICHAR*>( data + sizeof( record ) ), record.NameSize );
+    return FString( name.Length(), name.Get() );
+}
+
+TArrayView64<const uint8> FSCIFrameArchiveReader::GetPayload( int32 InIndex ) const
+{
+    const auto& entry = Entries[ InIndex ];
+    const auto data = GetSegmentData( entry.Segment, entry.Offset, entry.Size );
+    return data != nullptr ? TArrayView64<const uint8>( data, entry.Size ) : TArrayView64<const uint8>();
+}
+
+const uint8* FSCIFrameArchiveReader::GetSegmentData( uint32 InSegment, int64 InOffset, int64 InSize ) const
+{
+    if ( !Segments.IsValidIndex( InSegment ) )
+        return nullptr;
+
+    const auto& region = Segments[ InSegment ].Region;
+    if ( (InOffset < 0) || (InSize < 0) || (InOffset + InSize > region->GetMappedSize()) )
+        return nullptr;
+
+    return region->GetMappedPtr() + InOffset;
+}
+
+//-----------------------------------------------------------------------------
+
+static FAutoConsoleCommand GSCIExtractFrameArchiveCommand(
+    TEXT( "SCI.ExtractFrameArchive" ),
+    TEXT( "Writes every record of a frame archive back out as a file. Usage: SCI.ExtractFrameArchive <BaseFilename> [OutputDirectory]" ),
+    FConsoleCommandWithArgsDelegate::CreateLambda( []( const TArray<FString>& InArgs ){
+        if ( !InArgs.IsValidIndex( 0 ) ) {
+            VLOG( Warning, TEXT( "Usage: SCI.ExtractFrameArchive <BaseFilename> [OutputDirectory]" ) );
+            return;
+        }
+
+        // Relative names resolve against the saved directory, where the capture actor puts its archives.
+        auto baseFilename = InArgs[ 0 ];
+        baseFilename.RemoveFromEnd( TEXT( ".sciidx" ) );
+        if ( FPaths::IsRelative( baseFilename ) )
+            baseFilename = FPaths::ProjectSavedDir() / baseFilename;
+
+        const auto outputDirectory = InArgs.IsValidIndex( 1 ) ? InArgs[ 1 ] : FPaths::ProjectSavedDir() / TEXT( "Extracted" );
+
+        FSCIFrameArchiveReader reader;
+        if ( !reader.Open( baseFilename ) )
+            return;
+
+        int32 extractedCount = 0;
+        for ( int32 i = 0; i < reader.GetRecordCount(); i++ ) {
+            const auto name    = reader.GetName( i );
+            const auto payload = reader.GetPayload( i );
+            if ( name.IsEmpty() || (payload.GetData() == nullptr) ) {
+                VLOG( Warning, TEXT( "Skipped damaged frame archive record %d." ), i );
+                continue;
+            }
+
+            if ( FFileHelper::SaveArrayToFile( TArrayView<const uint8>( payload.GetData(), (int32)payload.Num() ), *(outputDirectory / name) ) )
+                extractedCount++;
+        }
+
+        VLOG( Display, TEXT( "Extracted %d of %d records to %s" ), extractedCount, reader.GetRecordCount(), *outputDirectory );
+    })
+);
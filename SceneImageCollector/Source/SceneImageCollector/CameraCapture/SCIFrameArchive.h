@@ -0,0 +1,138 @@
+// Copyright Devcoder.
+#pragma once
+#include "SCIAsyncSaveImageTask.h"
+#include <CoreMinimal.h>
+
+class IFileHandle;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// Append-only frame archive: encoded images packed back to back into large segment files,
+// plus one index of fixed-width entries, so millions of frames become a handful of files.
+//
+//   <Base>.sciidx          FIndexHeader, then one FEntry per record in append order
+//   <Base>_<NNNNN>.scia    FSegmentHeader padded to ALIGNMENT, then records
+//
+// A record is a FRecordHeader followed by the UTF-8 name (the image path relative to the
+// archive root), padded so the payload starts on an ALIGNMENT boundary. All integers are
+// little-endian. An index entry is only written after its payload, so an interrupted run
+// still leaves a readable archive.
+class FSCIFrameArchive
+{
+public:
+    static constexpr int64 ALIGNMENT = 4096;
+
+#pragma pack( push, 1 )
+    struct FIndexHeader
+    {
+        ANSICHAR Magic[ 4 ] = { 'S', 'C', 'I', 'I' };
+        uint32 Version = 1;
+        uint32 EntrySize = 32;
+        uint32 Reserved = 0;
+        int64 SegmentSize = 0;
+    };
+
+    struct FEntry
+    {
+        int64 FrameId;
+        // Payload position and size inside the segment.
+        int64 Offset;
+        int64 Size;
+        uint32 Segment;
+        // Distance from the record header to the payload.
+        uint32 HeaderSize;
+    };
+
+    struct FSegmentHeader
+    {
+        ANSICHAR Magic[ 4 ] = { 'S', 'C', 'I', 'S' };
+        uint32 Version = 1;
+        uint32 Segment = 0;
+        uint32 Reserved = 0;
+    };
+
+    struct FRecordHeader
+    {
+        ANSICHAR Magic[ 4 ] = { 'S', 'C', 'I', 'R' };
+        uint32 NameSize = 0;
+        int64 Size = 0;
+    };
+#pragma pack( pop )
+
+    static_assert( sizeof( FEntry ) == 32, "The index entry layout is part of the file format." );
+
+    static FString GetIndexFilename( const FString& InBaseFilename );
+    static FString GetSegmentFilename( const FString& InBaseFilename, int32 InSegment );
+};
+
+//-----------------------------------------------------------------------------
+
+// Thread safe, every writer thread appends to the same open segment.
+class FSCIFrameArchiveWriter : public ISCIFrameContainer
+{
+public:
+    FSCIFrameArchiveWriter();
+    virtual ~FSCIFrameArchiveWriter();
+
+    // Names are stored relative to InRootDirectory.
+    bool Open( const FString& InBaseFilename, const FString& InRootDirectory, int64 InSegmentSize );
+    void Close();
+    bool IsOpen() const;
+
+    virtual bool Append( int64 InFrameId, const FString& InName, const TArray64<uint8>& InData ) override;
+
+    int32 GetRecordCount() const;
+    int64 GetWrittenSize() const;
+
+private:
+    bool OpenSegment( int64 InMinimumSize );
+    void CloseSegment();
+
+private:
+    mutable FCriticalSection Mutex;
+    FString BaseFilename;
+    FString RootDirectory;
+    int64 SegmentSize;
+    int32 SegmentIndex;
+    int64 SegmentOffset;
+    TUniquePtr<IFileHandle> Segment;
+    TUniquePtr<IFileHandle> Index;
+    int32 RecordCount;
+    int64 WrittenSize;
+};
+
+//-----------------------------------------------------------------------------
+
+// Memory maps the segments for random access, records are never copied unless asked for.
+class FSCIFrameArchiveReader
+{
+public:
+    FSCIFrameArchiveReader();
+    ~FSCIFrameArchiveReader();
+
+    bool Open( const FString& InBaseFilename );
+    void Close();
+
+    int32 GetRecordCount() const;
+    const FSCIFrameArchive::FEntry& GetEntry( int32 InIndex ) const;
+    // INDEX_NONE when the archive holds no record with that name for the frame.
+    int32 FindRecord( int64 InFrameId, const FString& InName = FString() ) const;
+
+    FString GetName( int32 InIndex ) const;
+    // Valid until the reader is closed.
+    TArrayView64<const uint8> GetPayload( int32 InIndex ) const;
+
+private:
+    const uint8* GetSegmentData( uint32 InSegment, int64 InOffset, int64 InSize ) const;
+
+private:
+    struct FSegment
+    {
+        TUniquePtr<IMappedFileHandle> File;
+        TUniquePtr<IMappedFileRegion> Region;
+    };
+
+    TArray<FSCIFrameArchive::FEntry> Entries;
+    TArray<FSegment> Segments;
+    TMultiMap<int64, int32> FrameRecords;
+};
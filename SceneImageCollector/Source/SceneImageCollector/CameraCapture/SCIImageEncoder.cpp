@@ -0,0 +1,356 @@
+#include "SCIImageEncoder.h"
+#include "SCIAsyncSaveImageTask.h"
+#include "SCIImageEncoderRegistry.h"
+#include "SCIImageFormat.h"
+#include "SCIImageResampler.h"
+#include "../VLog.h"
+#include <Misc/Paths.h>
+#include <Misc/QueuedThreadPool.h>
+#include <Misc/ScopeLock.h>
+#include <Modules/ModuleManager.h>
+#include <ImageWrapper/Public/IImageWrapperModule.h>
+
+FSCIEncodeImageTask::FSCIEncodeImageTask( FSCIEncodeJob&& InJob, FSCIImageEncoderPool* InOwner )
+: Job( MoveTemp( InJob ) ), Owner( InOwner )
+{
+}
+
+void FSCIEncodeImageTask::DoWork()
+{
+    if ( IsResampled() )
+        ResampleSource();
+
+    // The smaller levels are taken before the encoders hand the source back.
+    if ( Job.LadderLevels > 0 )
+        BuildLadder();
+
+    TArray64<uint8> imageData;
+    if ( Encode( imageData ) ) {
+        // The compressed payload is moved, never copied, into the writer.
+        if ( !imageData.IsEmpty() )
+            Owner->Write( MoveTemp( imageData ), Job.Filename, Job.FrameId );
+    }
+    else {
+        VLOG( Error, TEXT( "Failed to encode image: %s" ), *Job.Filename );
+    }
+
+    if ( !Ladder.IsEmpty() )
+        WriteLadder();
+
+    Owner->OnJobFinished();
+}
+
+bool FSCIEncodeImageTask::Encode( TArray64<uint8>& OutImageData )
+{
+    // The encoders may release the source, so its size is taken first.
+    const auto rawSize    = Job.RawSize;
+    const auto startCycle = FPlatformTime::Cycles64();
+    const auto isEncoded  = FSCIImageEncoderRegistry::Get( Job.ImageFormat ).Encode( *this, OutImageData );
+    if ( isEncoded )
+        Owner->AddEncodeStats( rawSize, OutImageData.Num(), FPlatformTime::Cycles64() - startCycle );
+
+    return isEncoded;
+}
+
+void FSCIEncodeImageTask::BuildLadder()
+{
+    const auto isColor = (Job.RGBFormat == ERGBFormat::BGRA) && (Job.BitDepth == 8);
+    const auto isHalf  = (Job.RGBFormat == ERGBFormat::RGBAF) && (Job.BitDepth == 16);
+    if ( !isColor && !isHalf ) {
+        VLOG( Warning, TEXT( "Unsupported pixel layout for the resolution ladder: %s" ), *Job.Filename );
+        return;
+    }
+
+    // Each level halves the one before it, so the work shrinks to a third of the full frame.
+    const auto pixelSize = isColor ? (int64)sizeof( FColor ) : (int64)sizeof( FFloat16Color );
+    auto source           = static_cast<const uint8*>( Job.RawData );
+    auto sourceResolution = Job.Resolution;
+    for ( int32 i = 0; i < Job.LadderLevels; i++ ) {
+        const auto resolution = FSCIImageResampler::GetHalfResolution( sourceResolution );
+        if ( (resolution.X < 1) || (resolution.Y < 1) )
+            break;
+
+        auto& level = Ladder.AddDefaulted_GetRef();
+        level.Resolution = resolution;
+        level.Data.SetNumUninitialized( (int64)resolution.X * resolution.Y * pixelSize );
+        if ( isColor )
+            FSCIImageResampler::DownsampleHalf( reinterpret_cast<const FColor*>( source ), sourceResolution, reinterpret_cast<FColor*>( level.Data.GetData() ) );
+        else
+            FSCIImageResampler::DownsampleHalf( reinterpret_cast<const FFloat16Color*>( source ), sourceResolution, reinterpret_cast<FFloat16Color*>( level.Data.GetData() ) );
+
+        source           = level.Data.GetData();
+        sourceResolution = resolution;
+    }
+}
+
+void FSCIEncodeImageTask::WriteLadder()
+{
+    // The levels carry the color pixels only; layers and previews stay with the full-size file.
+    const auto basePath  = FPaths::Combine( FPaths::GetPath( Job.Filename ), FPaths::GetBaseFilename( Job.Filename ) );
+    const auto extension = FPaths::GetExtension( Job.Filename, true );
+    Job.DepthData  = nullptr;
+    Job.NormalData = nullptr;
+    Job.PreviewFilename.Empty();
+
+    for ( auto& level : Ladder ) {
+        Job.RawData    = level.Data.GetData();
+        Job.RawSize    = level.Data.Num();
+        Job.Resolution = level.Resolution;
+        Job.Filename   = FString::Printf( TEXT( "%s_%dx%d%s" ), *basePath, level.Resolution.X, level.Resolution.Y, *extension );
+
+        TArray64<uint8> imageData;
+        if ( Encode( imageData ) )
+            Owner->Write( MoveTemp( imageData ), Job.Filename, Job.FrameId );
+        else
+            VLOG( Error, TEXT( "Failed to encode image: %s" ), *Job.Filename );
+    }
+
+    Ladder.Empty();
+}
+
+bool FSCIEncodeImageTask::IsResampled() const
+{
+    return (Job.OutputResolution.X > 0) && (Job.OutputResolution.Y > 0) && (Job.OutputResolution != Job.Resolution);
+}
+
+void FSCIEncodeImageTask::ResampleSource()
+{
+    const auto pixelCount = (int64)Job.OutputResolution.X * Job.OutputResolution.Y;
+    if ( (Job.RGBFormat == ERGBFormat::BGRA) && (Job.BitDepth == 8) ) {
+        ResampledData.SetNumUninitialized( pixelCount * sizeof( FColor ) );
+        FSCIImageResampler::Resize( static_cast<const FColor*>( Job.RawData ), Job.Resolution
+        , reinterpret_cast<FColor*>( ResampledData.GetData() ), Job.OutputResolution );
+    }
+    else if ( (Job.RGBFormat == ERGBFormat::RGBAF) && (Job.BitDepth == 16) ) {
+        ResampledData.SetNumUninitialized( pixelCount * sizeof( FFloat16Color ) );
+        FSCIImageResampler::Resize( static_cast<const FFloat16Color*>( Job.RawData ), Job.Resolution
+        , reinterpret_cast<FFloat16Color*>( ResampledData.GetData() ), Job.OutputResolution );
+    }
+    else {
+        VLOG( Warning, TEXT( "Unsupported pixel layout for resampling: %s" ), *Job.Filename );
+        return;
+    }
+
+    // The encoders read the resampled copy, so the shared buffer can go back right away.
+    ReleaseSource();
+
+    Job.RawData    = ResampledData.GetData();
+    Job.RawSize    = ResampledData.Num();
+    Job.Resolution = Job.OutputResolution;
+}
+
+const FSCIEncodeJob& FSCIEncodeImageTask::GetJob() const
+{
+    return Job;
+}
+
+void FSCIEncodeImageTask::ReleaseSource()
+{
+    if ( Job.OnFinished ) {
+        Job.OnFinished();
+        Job.OnFinished = TUniqueFunction<void()>();
+    }
+}
+
+void FSCIEncodeImageTask::Write( TArray64<uint8>&& InImage, const FString& InImageName )
+{
+    Owner->Write( MoveTemp( InImage ), InImageName, Job.FrameId );
+}
+
+bool FSCIEncodeImageTask::EncodeWithImageWrapper( TArray64<uint8>& OutImageData )
+{
+    auto imageWrapper = Owner->ImageWrappers.Acquire( Job.ImageFormat );
+    const auto isRawSet = imageWrapper.IsValid() 
+    && imageWrapper->SetRaw( Job.RawData, Job.RawSize, Job.Resolution.X, Job.Resolution.Y, Job.RGBFormat, Job.BitDepth );
+
+    // The raw pixels are copied into the wrapper, so the buffer can go back to its owner.
+    ReleaseSource();
+
+    if ( isRawSet )
+        OutImageData = imageWrapper->GetCompressed( Job.Quality );
+
+    Owner->ImageWrappers.Release( Job.ImageFormat, MoveTemp( imageWrapper ) );
+    return isRawSet;
+}
+
+TStatId FSCIEncodeImageTask::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT( FSCIEncodeImageTask, STATGROUP_ThreadPoolAsyncTasks );
+}
+
+//-----------------------------------------------------------------------------
+
+FSCIImageWrapperPool::FSCIImageWrapperPool()
+{
+    ImageWrapperModule = nullptr;
+}
+
+void FSCIImageWrapperPool::Initialize( IImageWrapperModule* InImageWrapperModule )
+{
+    Empty();
+    ImageWrapperModule = InImageWrapperModule;
+}
+
+void FSCIImageWrapperPool::Empty()
+{
+    FScopeLock lock( &Mutex );
+    FreeWrappers.Empty();
+}
+
+TSharedPtr<IImageWrapper> FSCIImageWrapperPool::Acquire( ESCIImageFormat InImageFormat )
+{
+    {
+        FScopeLock lock( &Mutex );
+        auto freeWrappers = FreeWrappers.Find( InImageFormat );
+        if ( (freeWrappers != nullptr) && !freeWrappers->IsEmpty() )
+            return freeWrappers->Pop( false );
+    }
+
+    return ImageWrapperModule != nullptr ? ImageWrapperModule->CreateImageWrapper( FSCIImageEncoderRegistry::Get( InImageFormat ).GetImageWrapperFormat() ) : nullptr;
+}
+
+void FSCIImageWrapperPool::Release( ESCIImageFormat InImageFormat, TSharedPtr<IImageWrapper> InImageWrapper )
+{
+    if ( !InImageWrapper.IsValid() )
+        return;
+
+    FScopeLock lock( &Mutex );
+    FreeWrappers.FindOrAdd( InImageFormat ).Push( MoveTemp( InImageWrapper ) );
+}
+
+//-----------------------------------------------------------------------------
+
+float FSCIEncodeStats::GetCompressionRatio() const
+{
+    return EncodedSize > 0 ? (float)((double)RawSize / EncodedSize) : 0.0f;
+}
+
+float FSCIEncodeStats::GetMegabytesPerSecond() const
+{
+    return Seconds > 0.0 ? (float)(RawSize / (1024.0 * 1024.0) / Seconds) : 0.0f;
+}
+
+//-----------------------------------------------------------------------------
+
+FSCIImageEncoderPool::FSCIImageEncoderPool()
+{
+    ThreadPool        = nullptr;
+    Writer            = nullptr;
+    InFlightCount     = 0;
+    MaxInFlight       = 0;
+    EncodedImageCount = 0;
+    EncodedRawSize    = 0;
+    EncodedSize       = 0;
+    EncodeCycles      = 0;
+}
+
+FSCIImageEncoderPool::~FSCIImageEncoderPool()
+{
+    Release();
+}
+
+void FSCIImageEncoderPool::Initialize( int32 InWorkerCount, int32 InMaxInFlight, FSCIImageWriterPool* InWriter )
+{
+    Release();
+
+    Writer            = InWriter;
+    EncodedImageCount = 0;
+    EncodedRawSize    = 0;
+    EncodedSize       = 0;
+    EncodeCycles      = 0;
+    // Load the image wrapper module on the game thread, workers only create wrappers.
+    ImageWrappers.Initialize( &FModuleManager::LoadModuleChecked<IImageWrapperModule>( FName( TEXT( "ImageWrapper" ) ) ) );
+    MaxInFlight = FMath::Max( InMaxInFlight, 1 );
+
+    ThreadPool = FQueuedThreadPool::Allocate();
+    ThreadPool->Create( FMath::Max( InWorkerCount, 1 ), 128 * 1024, TPri_BelowNormal, TEXT( "SCIEncoderPool" ) );
+}
+
+void FSCIImageEncoderPool::Release()
+{
+    if ( ThreadPool == nullptr )
+        return;
+
+    // Jobs still reference the pixel buffers of their owner.
+    while ( InFlightCount.Load() > 0 )
+        FPlatformProcess::Sleep( 0.001f );
+
+    ThreadPool->Destroy();
+    delete ThreadPool;
+    ThreadPool = nullptr;
+
+    ImageWrappers.Empty();
+}
+
+ESCISubmitResult FSCIImageEncoderPool::TrySubmit( FSCIEncodeJob&& InJob )
+{
+    if ( (ThreadPool == nullptr) || IsSaturated() )
+        return ESCISubmitResult::WouldBlock;
+
+    InFlightCount++;
+    (new FAutoDeleteAsyncTask<FSCIEncodeImageTask>( MoveTemp( InJob ), this ))->StartBackgroundTask( ThreadPool );
+    return ESCISubmitResult::Accepted;
+}
+
+ESCISubmitResult FSCIImageEncoderPool::TrySubmit( TArray<FSCIEncodeJob>& InOutJobs )
+{
+    // A batch larger than the limit still goes through once the pool has drained.
+    const auto inFlightCount = InFlightCount.Load();
+    if ( (ThreadPool == nullptr) 
+    || ((inFlightCount > 0) && (inFlightCount + InOutJobs.Num() > MaxInFlight)) 
+    || ((Writer != nullptr) && Writer->IsSaturated()) )
+        return ESCISubmitResult::WouldBlock;
+
+    for ( auto& job : InOutJobs ) {
+        InFlightCount++;
+        (new FAutoDeleteAsyncTask<FSCIEncodeImageTask>( MoveTemp( job ), this ))->StartBackgroundTask( ThreadPool );
+    }
+    InOutJobs.Reset();
+    return ESCISubmitResult::Accepted;
+}
+
+bool FSCIImageEncoderPool::IsSaturated() const
+{
+    return (InFlightCount.Load() >= MaxInFlight) || ((Writer != nullptr) && Writer->IsSaturated());
+}
+
+int32 FSCIImageEncoderPool::GetInFlightCount() const
+{
+    return InFlightCount.Load();
+}
+
+FSCIEncodeStats FSCIImageEncoderPool::GetEncodeStats() const
+{
+    FSCIEncodeStats stats;
+    stats.ImageCount  = EncodedImageCount.Load();
+    stats.RawSize     = EncodedRawSize.Load();
+    stats.EncodedSize = EncodedSize.Load();
+    stats.Seconds     = FPlatformTime::ToSeconds64( EncodeCycles.Load() );
+    return stats;
+}
+
+void FSCIImageEncoderPool::Write( TArray64<uint8>&& InImage, const FString& InImageName, int64 InFrameId )
+{
+    if ( Writer == nullptr ) {
+        FSCIAsyncSaveImageTask saveTask( MoveTemp( InImage ), InImageName, nullptr, InFrameId );
+        saveTask.DoWork();
+        return;
+    }
+
+    // A full writer queue blocks this worker, which in turn keeps the actor from submitting.
+    while ( Writer->TrySubmit( MoveTemp( InImage ), InImageName, InFrameId ) == ESCISubmitResult::WouldBlock )
+        FPlatformProcess::Sleep( 0.001f );
+}
+
+void FSCIImageEncoderPool::AddEncodeStats( int64 InRawSize, int64 InEncodedSize, uint64 InCycles )
+{
+    EncodedImageCount++;
+    EncodedRawSize += InRawSize;
+    EncodedSize    += InEncodedSize;
+    EncodeCycles   += InCycles;
+}
+
+void FSCIImageEncoderPool::OnJobFinished()
+{
+    InFlightCount--;
+}
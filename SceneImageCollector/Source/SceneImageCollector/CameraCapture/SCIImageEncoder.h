@@ -0,0 +1,167 @@
+// Copyright Devcoder.
+#pragma once
+#include "SCIAsyncSaveImageTask.h"
+#include <CoreMinimal.h>
+#include <Async/AsyncWork.h>
+#include <ImageWrapper/Public/IImageWrapper.h>
+
+enum class ESCIImageFormat;
+
+// Move-only: the job owns the borrowed pixel buffer until OnFinished hands it back.
+struct FSCIEncodeJob
+{
+    FSCIEncodeJob() = default;
+    FSCIEncodeJob( FSCIEncodeJob&& ) = default;
+    FSCIEncodeJob& operator=( FSCIEncodeJob&& ) = default;
+    FSCIEncodeJob( const FSCIEncodeJob& ) = delete;
+    FSCIEncodeJob& operator=( const FSCIEncodeJob& ) = delete;
+
+    const void* RawData = nullptr;
+    int64 RawSize = 0;
+    FIntPoint Resolution = FIntPoint::ZeroValue;
+    // Rescaled on the worker when set and different from Resolution.
+    FIntPoint OutputResolution = FIntPoint::ZeroValue;
+    ERGBFormat RGBFormat = ERGBFormat::BGRA;
+    int32 BitDepth = 8;
+    ESCIImageFormat ImageFormat;
+    int32 Quality = 0;
+    // zlib level used by the banded png and the exr encoder, zstd level for compressed raw.
+    // Defaults to zlib's own default, 0 would store the png uncompressed.
+    int32 CompressionLevel = 6;
+    // zstd workers compressing one raw frame, 0 compresses on the encoder worker itself.
+    int32 CompressionWorkerCount = 0;
+    // Compressed raw frames train and then use it, optional.
+    class FSCIRawDictionary* RawDictionary = nullptr;
+    bool IsUseParallelPng = false;
+    // Jpeg chroma layout and restart interval in MCU rows.
+    bool IsChromaSubsampled = true;
+    int32 RestartInterval = 0;
+    bool IsWriteAlpha = true;
+    // Optional exr layers of the same size as the color pixels, float depth and half-float normals.
+    const float* DepthData = nullptr;
+    const void* NormalData = nullptr;
+    // 8-bit preview tonemapped from the same linear exr pixels, skipped when the name is empty.
+    FString PreviewFilename;
+    // Value-initialized to the first format, PNG; the enum is only forward declared here.
+    ESCIImageFormat PreviewFormat = {};
+    int32 PreviewQuality = 85;
+    float PreviewExposure = 1.0f;
+    // Npy files the npy formats write the frame into, at slot FrameId.
+    class FSCINpyWriter* NpyFile = nullptr;
+    class FSCINpyWriter* DepthNpyFile = nullptr;
+    // Extra files at half, quarter, ... size, each named with a _WxH suffix.
+    int32 LadderLevels = 0;
+    FString Filename;
+    // Archive key of every file written for this job.
+    int64 FrameId = INDEX_NONE;
+    // Called on the worker once the raw pixels are no longer needed.
+    TUniqueFunction<void()> OnFinished;
+};
+
+// Totals over every image the pool has encoded, to compare formats and settings.
+struct FSCIEncodeStats
+{
+    int64 ImageCount = 0;
+    int64 RawSize = 0;
+    int64 EncodedSize = 0;
+    // Summed over the workers, so the throughput is per worker.
+    double Seconds = 0.0;
+
+    float GetCompressionRatio() const;
+    float GetMegabytesPerSecond() const;
+};
+
+//-----------------------------------------------------------------------------
+
+class FSCIEncodeImageTask : public FNonAbandonableTask
+{
+public:
+    FSCIEncodeImageTask( FSCIEncodeJob&& InJob, class FSCIImageEncoderPool* InOwner );
+
+    void DoWork();
+    TStatId GetStatId() const;
+
+    // Used by the format encoders.
+    const FSCIEncodeJob& GetJob() const;
+    void ReleaseSource();
+    // Queues an extra file, such as a preview, next to the encoded image.
+    void Write( TArray64<uint8>&& InImage, const FString& InImageName );
+    bool EncodeWithImageWrapper( TArray64<uint8>& OutImageData );
+
+protected:
+    bool IsResampled() const;
+    void ResampleSource();
+    void BuildLadder();
+    void WriteLadder();
+    bool Encode( TArray64<uint8>& OutImageData );
+
+protected:
+    FSCIEncodeJob Job;
+    class FSCIImageEncoderPool* Owner;
+    TArray64<uint8> ResampledData;
+
+    struct FLadderLevel
+    {
+        FIntPoint Resolution;
+        TArray64<uint8> Data;
+    };
+    TArray<FLadderLevel> Ladder;
+};
+
+//-----------------------------------------------------------------------------
+
+// Image wrappers keep per-call state, so every worker borrows its own instance per format.
+class FSCIImageWrapperPool
+{
+public:
+    FSCIImageWrapperPool();
+
+    void Initialize( class IImageWrapperModule* InImageWrapperModule );
+    void Empty();
+
+    TSharedPtr<IImageWrapper> Acquire( ESCIImageFormat InImageFormat );
+    void Release( ESCIImageFormat InImageFormat, TSharedPtr<IImageWrapper> InImageWrapper );
+
+private:
+    class IImageWrapperModule* ImageWrapperModule;
+    FCriticalSection Mutex;
+    TMap<ESCIImageFormat, TArray<TSharedPtr<IImageWrapper>>> FreeWrappers;
+};
+
+//-----------------------------------------------------------------------------
+
+// Dedicated worker pool that compresses captured frames and hands them to the writer pool,
+// so the game thread only has to enqueue. The number of jobs in flight is bounded.
+class FSCIImageEncoderPool
+{
+    friend class FSCIEncodeImageTask;
+public:
+    FSCIImageEncoderPool();
+    ~FSCIImageEncoderPool();
+
+    void Initialize( int32 InWorkerCount, int32 InMaxInFlight, class FSCIImageWriterPool* InWriter );
+    void Release();
+
+    ESCISubmitResult TrySubmit( FSCIEncodeJob&& InJob );
+    // All or nothing; accepted jobs are moved out of the array.
+    ESCISubmitResult TrySubmit( TArray<FSCIEncodeJob>& InOutJobs );
+    bool IsSaturated() const;
+    int32 GetInFlightCount() const;
+    FSCIEncodeStats GetEncodeStats() const;
+
+private:
+    void Write( TArray64<uint8>&& InImage, const FString& InImageName, int64 InFrameId );
+    void AddEncodeStats( int64 InRawSize, int64 InEncodedSize, uint64 InCycles );
+    void OnJobFinished();
+
+private:
+    FQueuedThreadPool* ThreadPool;
+    FSCIImageWrapperPool ImageWrappers;
+    class FSCIImageWriterPool* Writer;
+    TAtomic<int32> InFlightCount;
+    int32 MaxInFlight;
+    TAtomic<int64> EncodedImageCount;
+    TAtomic<int64> EncodedRawSize;
+    TAtomic<int64> EncodedSize;
+    TAtomic<uint64> EncodeCycles;
+};
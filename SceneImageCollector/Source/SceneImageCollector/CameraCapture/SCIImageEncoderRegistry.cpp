@@ -0,0 +1,374 @@
+#include "SCIImageEncoderRegistry.h"
+#include "SCIExrEncoder.h"
+#include "SCIImageEncoder.h"
+#include "SCIJpegEncoder.h"
+#include "SCINpyWriter.h"
+#include "SCIPixelKernels.h"
+#include "SCIPngEncoder.h"
+#include "SCIQoiEncoder.h"
+#include "SCIRawCompressor.h"
+#include "../VLog.h"
+
+namespace SCI
+{
+    FORCEINLINE bool IsColor8Job( const FSCIEncodeJob& InJob )
+    {
+        return (InJob.RGBFormat == ERGBFormat::BGRA) && (InJob.BitDepth == 8);
+    }
+
+    FORCEINLINE bool IsFloat16Job( const FSCIEncodeJob& InJob )
+    {
+        return (InJob.RGBFormat == ERGBFormat::RGBAF) && (InJob.BitDepth == 16);
+    }
+
+    class FPngImageEncoder : public ISCIImageEncoder
+    {
+    public:
+        virtual ESCICaptureFormat GetCaptureFormat() const override { return ESCICaptureFormat::Color8; }
+        virtual const TCHAR* GetExtension() const override { return TEXT( ".png" ); }
+
+        virtual bool Encode( FSCIEncodeImageTask& InTask, TArray64<uint8>& OutImageData ) const override
+        {
+            const auto& job = InTask.GetJob();
+            if ( !job.IsUseParallelPng || !IsColor8Job( job ) )
+                return InTask.EncodeWithImageWrapper( OutImageData );
+
+            // Reads straight from the readback buffer, so the pixels are never copied.
+            FSCIPngEncoder::FSource source;
+            source.Data       = static_cast<const uint8*>( job.RawData );
+            source.Resolution = job.Resolution;
+            source.IsBGRA     = true;
+
+            const auto isEncoded = FSCIPngEncoder::Encode( source, job.CompressionLevel, 0, OutImageData );
+            InTask.ReleaseSource();
+            return isEncoded;
+        }
+    };
+
+    class FJpegImageEncoder : public ISCIImageEncoder
+    {
+    public:
+        virtual ESCICaptureFormat GetCaptureFormat() const override { return ESCICaptureFormat::Color8; }
+        virtual const TCHAR* GetExtension() const override { return TEXT( ".jpeg" ); }
+        virtual EImageFormat GetImageWrapperFormat() const override { return EImageFormat::JPEG; }
+        virtual int32 GetQuality( const FSCIEncodeSettings& InSettings ) const override { return InSettings.JpgQuality; }
+
+        virtual bool Encode( FSCIEncodeImageTask& InTask, TArray64<uint8>& OutImageData ) const override
+        {
+            const auto& job = InTask.GetJob();
+            if ( !IsColor8Job( job ) || !FSCIJpegEncoder::IsAvailable() )
+                return InTask.EncodeWithImageWrapper( OutImageData );
+
+            FSCIJpegEncoder::FOptions options;
+            options.Quality            = job.Quality;
+            options.IsChromaSubsampled = job.IsChromaSubsampled;
+            options.RestartInterval    = job.RestartInterval;
+
+            const auto isEncoded = FSCIJpegEncoder::Encode( static_cast<const FColor*>( job.RawData ), job.Resolution, options, OutImageData );
+            InTask.ReleaseSource();
+            return isEncoded;
+        }
+    };
+
+    class FQoiImageEncoder : public ISCIImageEncoder
+    {
+    public:
+        virtual ESCICaptureFormat GetCaptureFormat() const override { return ESCICaptureFormat::Color8; }
+        virtual const TCHAR* GetExtension() const override { return TEXT( ".qoi" ); }
+
+        virtual bool Encode( FSCIEncodeImageTask& InTask, TArray64<uint8>& OutImageData ) const override
+        {
+            const auto& job = InTask.GetJob();
+            const auto isEncoded = IsColor8Job( job )
+            && FSCIQoiEncoder::Encode( static_cast<const FColor*>( job.RawData ), job.Resolution, OutImageData );
+            InTask.ReleaseSource();
+            return isEncoded;
+        }
+    };
+
+    class FExrImageEncoder : public ISCIImageEncoder
+    {
+    public:
+        virtual ESCICaptureFormat GetCaptureFormat() const override { return ESCICaptureFormat::Float16; }
+        virtual const TCHAR* GetExtension() const override { return TEXT( ".exr" ); }
+        virtual EImageFormat GetImageWrapperFormat() const override { return EImageFormat::EXR; }
+        virtual int32 GetQuality( const FSCIEncodeSettings& InSettings ) const override { return (int32)EImageCompressionQuality::Uncompressed; }
+        virtual int32 GetCompressionLevel( const FSCIEncodeSettings& InSettings ) const override { return InSettings.ExrCompressionLevel; }
+        virtual bool IsDepthLayerSupported() const override { return true; }
+        virtual bool IsNormalLayerSupported() const override { return true; }
+        virtual bool IsPreviewSupported() const override { return true; }
+
+        virtual bool Encode( FSCIEncodeImageTask& InTask, TArray64<uint8>& OutImageData ) const override
+        {
+            const auto& job = InTask.GetJob();
+            if ( !IsFloat16Job( job ) )
+                return InTask.EncodeWithImageWrapper( OutImageData );
+
+            // Keeps the half-float samples as they are, no float conversion.
+            TArray<FSCIExrEncoder::FChannel> channels;
+            FSCIExrEncoder::GetColorChannels( static_cast<const FFloat16Color*>( job.RawData ), job.IsWriteAlpha, channels );
+            FSCIExrEncoder::GetLayerChannels( job.DepthData, static_cast<const FFloat16Color*>( job.NormalData ), channels );
+
+            // The preview is tonemapped from the same readback before the pixels go back to the pool.
+            TArray<FColor> previewPixels;
+            if ( !job.PreviewFilename.IsEmpty() ) {
+                previewPixels.SetNumUninitialized( job.Resolution.X * job.Resolution.Y );
+                FSCIPixelKernels::TonemapToSrgb8( static_cast<const FFloat16Color*>( job.RawData ), previewPixels.Num(), job.PreviewExposure, previewPixels.GetData() );
+            }
+
+            const auto isEncoded = FSCIExrEncoder::Encode( MoveTemp( channels ), job.Resolution, job.CompressionLevel, OutImageData );
+            InTask.ReleaseSource();
+
+            if ( !previewPixels.IsEmpty() )
+                WritePreview( InTask, previewPixels );
+
+            return isEncoded;
+        }
+
+    private:
+        static void WritePreview( FSCIEncodeImageTask& InTask, const TArray<FColor>& InPixels )
+        {
+            const auto& job = InTask.GetJob();
+            TArray64<uint8> previewData;
+            auto isEncoded = false;
+            // Jpeg previews need libjpeg-turbo, png is written instead where it is missing.
+            const auto previewFormat = ((job.PreviewFormat == ESCIImageFormat::JPG) && !FSCIJpegEncoder::IsAvailable()) ? ESCIImageFormat::PNG : job.PreviewFormat;
+            switch ( previewFormat ) {
+                case ESCIImageFormat::JPG: {
+                    FSCIJpegEncoder::FOptions options;
+                    options.Quality = job.PreviewQuality;
+                    isEncoded = FSCIJpegEncoder::Encode( InPixels.GetData(), job.Resolution, options, previewData );
+                    break;
+                }
+                case ESCIImageFormat::QOI:
+                    isEncoded = FSCIQoiEncoder::Encode( InPixels.GetData(), job.Resolution, previewData );
+                    break;
+                default: {
+                    // Previews favour speed over size.
+                    FSCIPngEncoder::FSource source;
+                    source.Data       = reinterpret_cast<const uint8*>( InPixels.GetData() );
+                    source.Resolution = job.Resolution;
+                    isEncoded = FSCIPngEncoder::Encode( source, 1, 0, previewData );
+                    break;
+                }
+            }
+
+            if ( isEncoded )
+                InTask.Write( MoveTemp( previewData ), job.PreviewFilename );
+            else
+                VLOG( Error, TEXT( "Failed to encode preview: %s" ), *job.PreviewFilename );
+        }
+    };
+
+    class FPng16ImageEncoder : public ISCIImageEncoder
+    {
+    public:
+        virtual ESCICaptureFormat GetCaptureFormat() const override { return ESCICaptureFormat::Float16; }
+        virtual const TCHAR* GetExtension() const override { return TEXT( ".png" ); }
+
+        virtual bool Encode( FSCIEncodeImageTask& InTask, TArray64<uint8>& OutImageData ) const override
+        {
+            const auto& job = InTask.GetJob();
+            if ( !IsFloat16Job( job ) )
+                return InTask.EncodeWithImageWrapper( OutImageData );
+
+            // sRGB conversion and the big-endian swap happen in the same pass.
+            const auto pixelCount = (int64)job.Resolution.X * job.Resolution.Y;
+            TArray64<uint8> samples;
+            samples.SetNumUninitialized( pixelCount * 4 * sizeof( uint16 ) );
+            FSCIPixelKernels::HalfToSrgb16BigEndian( static_cast<const FFloat16Color*>( job.RawData ), pixelCount, reinterpret_cast<uint16*>( samples.GetData() ) );
+
+            FSCIPngEncoder::FSource source;
+            source.Data       = samples.GetData();
+            source.Resolution = job.Resolution;
+            source.IsBGRA     = false;
+            source.BitDepth   = 16;
+
+            InTask.ReleaseSource();
+            return FSCIPngEncoder::Encode( source, job.CompressionLevel, 0, OutImageData );
+        }
+    };
+
+    class FRawImageEncoder : public ISCIImageEncoder
+    {
+    public:
+        virtual ESCICaptureFormat GetCaptureFormat() const override { return ESCICaptureFormat::Color8; }
+        virtual bool CanEncode( ESCICaptureFormat InCaptureFormat ) const override { return true; }
+        virtual const TCHAR* GetExtension() const override { return TEXT( ".raw" ); }
+
+        virtual bool Encode( FSCIEncodeImageTask& InTask, TArray64<uint8>& OutImageData ) const override
+        {
+            // Pixels as captured, BGRA8 or RGBA16F without a header.
+            const auto& job = InTask.GetJob();
+            OutImageData.Append( static_cast<const uint8*>( job.RawData ), job.RawSize );
+            InTask.ReleaseSource();
+            return true;
+        }
+    };
+
+    class FRawCompressedImageEncoder : public ISCIImageEncoder
+    {
+    public:
+        virtual ESCICaptureFormat GetCaptureFormat() const override { return ESCICaptureFormat::Color8; }
+        virtual bool CanEncode( ESCICaptureFormat InCaptureFormat ) const override { return FSCIRawCompressor::IsAvailable(); }
+        virtual const TCHAR* GetExtension() const override { return TEXT( ".rawz" ); }
+        virtual int32 GetCompressionLevel( const FSCIEncodeSettings& InSettings ) const override { return InSettings.RawCompressionLevel; }
+        virtual bool IsUsingDictionary() const override { return true; }
+
+        virtual bool Encode( FSCIEncodeImageTask& InTask, TArray64<uint8>& OutImageData ) const override
+        {
+            const auto& job = InTask.GetJob();
+            const auto pixelCount = (int64)job.Resolution.X * job.Resolution.Y;
+            if ( pixelCount <= 0 ) {
+                InTask.ReleaseSource();
+                return false;
+            }
+
+            FSCIRawCompressor::FOptions options;
+            options.Level       = job.CompressionLevel;
+            options.WorkerCount = job.CompressionWorkerCount;
+            options.Dictionary  = job.RawDictionary;
+
+            // BGRA8 or RGBA16F as captured, the compressor shuffles the half floats itself.
+            const auto isEncoded = FSCIRawCompressor::Compress( static_cast<const uint8*>( job.RawData ), job.Resolution
+            , (int32)(job.RawSize / pixelCount), options, OutImageData );
+            InTask.ReleaseSource();
+
+            // Written once, by the worker that gets it first, the same way as the frames.
+            TArray64<uint8> dictionary;
+            if ( (job.RawDictionary != nullptr) && job.RawDictionary->TakeTrainedData( dictionary ) )
+                InTask.Write( MoveTemp( dictionary ), job.RawDictionary->GetFilename() );
+
+            return isEncoded;
+        }
+    };
+
+    // Readback pixels in the channel order of the npy file, RGB or RGBA.
+    void PackNpyColor( const FColor* InPixels, int64 InPixelCount, int32 InChannelCount, uint8* OutData )
+    {
+        if ( InChannelCount == 4 )
+            FSCIPixelKernels::BgraToRgba( InPixels, InPixelCount, OutData );
+        else
+            FSCIPixelKernels::BgraToRgb( InPixels, InPixelCount, OutData );
+    }
+
+    // The first InChannelCount of R, G, B and A.
+    void PackNpyHalf( const FFloat16Color* InPixels, int64 InPixelCount, int32 InChannelCount, FFloat16* OutData )
+    {
+        if ( InChannelCount == 4 ) {
+            FMemory::Memcpy( OutData, InPixels, InPixelCount * sizeof( FFloat16Color ) );
+            return;
+        }
+
+        for ( int64 i = 0; i < InPixelCount; i++, OutData += InChannelCount ) {
+            const auto channels = &InPixels[ i ].R;
+            for ( int32 channel = 0; channel < InChannelCount; channel++ )
+                OutData[ channel ] = channels[ channel ];
+        }
+    }
+
+    class FNpyImageEncoder : public ISCIImageEncoder
+    {
+    public:
+        explicit FNpyImageEncoder( ESCICaptureFormat InCaptureFormat ) : CaptureFormat( InCaptureFormat ) {}
+
+        virtual ESCICaptureFormat GetCaptureFormat() const override { return CaptureFormat; }
+        virtual const TCHAR* GetExtension() const override { return TEXT( ".npy" ); }
+        virtual bool IsWritingNpyFile() const override { return true; }
+        virtual bool IsPrimaryOnly() const override { return true; }
+        virtual bool IsResolutionLadderSupported() const override { return false; }
+        // The npy depth file is the only layer, normals have no file to go to.
+        virtual bool IsDepthLayerSupported() const override { return CaptureFormat == ESCICaptureFormat::Float16; }
+
+        virtual bool Encode( FSCIEncodeImageTask& InTask, TArray64<uint8>& OutImageData ) const override
+        {
+            // The frame goes into its slot of the actor's npy file, no file of its own.
+            const auto& job = InTask.GetJob();
+            const auto npyFile = job.NpyFile;
+            if ( (npyFile == nullptr) || (npyFile->GetResolution() != job.Resolution) ) {
+                InTask.ReleaseSource();
+                return false;
+            }
+
+            const auto pixelCount = (int64)job.Resolution.X * job.Resolution.Y;
+            TArray64<uint8> slot;
+            slot.SetNumUninitialized( npyFile->GetSlotSize() );
+            if ( IsColor8Job( job ) && (npyFile->GetElementType() == FSCINpyWriter::EElementType::UInt8) ) {
+                PackNpyColor( static_cast<const FColor*>( job.RawData ), pixelCount, npyFile->GetChannelCount(), slot.GetData() );
+            }
+            else if ( IsFloat16Job( job ) && (npyFile->GetElementType() == FSCINpyWriter::EElementType::Float16) ) {
+                PackNpyHalf( static_cast<const FFloat16Color*>( job.RawData ), pixelCount, npyFile->GetChannelCount(), reinterpret_cast<FFloat16*>( slot.GetData() ) );
+            }
+            else {
+                InTask.ReleaseSource();
+                return false;
+            }
+
+            TArray64<uint8> depthSlot;
+            const auto depthNpyFile = job.DepthNpyFile;
+            if ( (depthNpyFile != nullptr) && (job.DepthData != nullptr) && (depthNpyFile->GetResolution() == job.Resolution) ) {
+                depthSlot.SetNumUninitialized( depthNpyFile->GetSlotSize() );
+                FMemory::Memcpy( depthSlot.GetData(), job.DepthData, depthSlot.Num() );
+            }
+
+            // The readback goes back before the slots are written.
+            InTask.ReleaseSource();
+
+            if ( !depthSlot.IsEmpty() )
+                depthNpyFile->Write( job.FrameId, depthSlot.GetData(), depthSlot.Num() );
+            return npyFile->Write( job.FrameId, slot.GetData(), slot.Num() );
+        }
+
+    private:
+        ESCICaptureFormat CaptureFormat;
+    };
+
+    struct FImageEncoderTable
+    {
+        TMap<ESCIImageFormat, TUniquePtr<ISCIImageEncoder>> Encoders;
+
+        FImageEncoderTable()
+        {
+            Encoders.Add( ESCIImageFormat::PNG, MakeUnique<FPngImageEncoder>() );
+            Encoders.Add( ESCIImageFormat::JPG, MakeUnique<FJpegImageEncoder>() );
+            Encoders.Add( ESCIImageFormat::EXR, MakeUnique<FExrImageEncoder>() );
+            Encoders.Add( ESCIImageFormat::QOI, MakeUnique<FQoiImageEncoder>() );
+            Encoders.Add( ESCIImageFormat::PNG16, MakeUnique<FPng16ImageEncoder>() );
+            Encoders.Add( ESCIImageFormat::RAW, MakeUnique<FRawImageEncoder>() );
+            Encoders.Add( ESCIImageFormat::RAWZ, MakeUnique<FRawCompressedImageEncoder>() );
+            Encoders.Add( ESCIImageFormat::NPY, MakeUnique<FNpyImageEncoder>( ESCICaptureFormat::Color8 ) );
+            Encoders.Add( ESCIImageFormat::NPY16, MakeUnique<FNpyImageEncoder>( ESCICaptureFormat::Float16 ) );
+        }
+
+        static FImageEncoderTable& Get()
+        {
+            static FImageEncoderTable TABLE;
+            return TABLE;
+        }
+    };
+}
+
+//-----------------------------------------------------------------------------
+
+void FSCIImageEncoderRegistry::Register( ESCIImageFormat InImageFormat, TUniquePtr<ISCIImageEncoder>&& InEncoder )
+{
+    // Workers read the table without a lock, so it only changes before capturing starts.
+    check( IsInGameThread() );
+    if ( ensure( InEncoder.IsValid() ) )
+        SCI::FImageEncoderTable::Get().Encoders.Add( InImageFormat, MoveTemp( InEncoder ) );
+}
+
+const ISCIImageEncoder* FSCIImageEncoderRegistry::Find( ESCIImageFormat InImageFormat )
+{
+    const auto encoder = SCI::FImageEncoderTable::Get().Encoders.Find( InImageFormat );
+    return encoder != nullptr ? encoder->Get() : nullptr;
+}
+
+const ISCIImageEncoder& FSCIImageEncoderRegistry::Get( ESCIImageFormat InImageFormat )
+{
+    const auto encoder = Find( InImageFormat );
+    if ( ensureMsgf( encoder != nullptr, TEXT( "No encoder registered for image format %d." ), (int32)InImageFormat ) )
+        return *encoder;
+
+    return *Find( ESCIImageFormat::PNG );
+}
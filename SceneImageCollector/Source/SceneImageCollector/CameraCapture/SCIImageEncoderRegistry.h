@@ -0,0 +1,110 @@
+// Copyright Devcoder.
+#pragma once
+#include "SCIImageFormat.h"
+#include <CoreMinimal.h>
+#include <Engine/EngineTypes.h>
+#include <Engine/TextureRenderTarget2D.h>
+#include <ImageWrapper/Public/IImageWrapper.h>
+
+// Pixels a format is encoded from, which decides the render target and the readback.
+enum class ESCICaptureFormat : uint8
+{
+    // BGRA8 from an sRGB render target.
+    Color8,
+    // RGBA16F linear HDR, post processed but neither tonemapped nor gamma encoded.
+    Float16
+};
+
+// Quality and compression settings of a capture, every format picks the ones it uses.
+struct FSCIEncodeSettings
+{
+    int32 JpgQuality = 85;
+    // zlib level of the png encoders, 0 stores the image uncompressed.
+    int32 PngCompressionLevel = 6;
+    int32 ExrCompressionLevel = 4;
+    // zstd level of compressed raw.
+    int32 RawCompressionLevel = 1;
+};
+
+// One output format: what it has to be captured as, how its files are named and how it is encoded.
+class ISCIImageEncoder
+{
+public:
+    virtual ~ISCIImageEncoder() = default;
+
+    virtual ESCICaptureFormat GetCaptureFormat() const = 0;
+    // Formats that take any readback as it is, such as RAW, say so here.
+    virtual bool CanEncode( ESCICaptureFormat InCaptureFormat ) const { return InCaptureFormat == GetCaptureFormat(); }
+    virtual const TCHAR* GetExtension() const = 0;
+    // Codec used when the job falls back to the engine image wrapper.
+    virtual EImageFormat GetImageWrapperFormat() const { return EImageFormat::PNG; }
+
+    // Quality handed to the engine image wrapper, whose png only knows stored or its default deflate level.
+    virtual int32 GetQuality( const FSCIEncodeSettings& InSettings ) const
+    {
+        return InSettings.PngCompressionLevel == 0 ? (int32)EImageCompressionQuality::Uncompressed : (int32)EImageCompressionQuality::Default;
+    }
+    virtual int32 GetCompressionLevel( const FSCIEncodeSettings& InSettings ) const { return InSettings.PngCompressionLevel; }
+    // The actor trains one zstd dictionary for every output that uses it.
+    virtual bool IsUsingDictionary() const { return false; }
+
+    // Formats that write every frame into the actor's npy files rather than a file of its own.
+    virtual bool IsWritingNpyFile() const { return false; }
+    // Only accepted as the actor's own format, not as an output sink.
+    virtual bool IsPrimaryOnly() const { return false; }
+    virtual bool IsResolutionLadderSupported() const { return true; }
+    // Depth and normal layers captured next to the color, and the 8-bit preview.
+    virtual bool IsDepthLayerSupported() const { return false; }
+    virtual bool IsNormalLayerSupported() const { return false; }
+    virtual bool IsPreviewSupported() const { return false; }
+
+    // Runs on an encoder worker. Calls InTask.ReleaseSource() as soon as the source pixels are no longer read.
+    // Formats that store the pixels themselves succeed with OutImageData left empty, nothing is written then.
+    virtual bool Encode( class FSCIEncodeImageTask& InTask, TArray64<uint8>& OutImageData ) const = 0;
+};
+
+// Formats are looked up here by the capture actor, its render target setup and the encoder workers.
+// The built-in formats are registered on first use; more can be added from the game thread before capturing starts.
+class FSCIImageEncoderRegistry
+{
+public:
+    static void Register( ESCIImageFormat InImageFormat, TUniquePtr<ISCIImageEncoder>&& InEncoder );
+    static const ISCIImageEncoder* Find( ESCIImageFormat InImageFormat );
+    // Falls back to png for a format nobody registered.
+    static const ISCIImageEncoder& Get( ESCIImageFormat InImageFormat );
+};
+
+namespace SCI
+{
+    FORCEINLINE ESCICaptureFormat GetCaptureFormat( ESCIImageFormat InImageFormat )
+    {
+        return FSCIImageEncoderRegistry::Get( InImageFormat ).GetCaptureFormat();
+    }
+
+    // Formats captured from the half-float render target.
+    FORCEINLINE bool IsFloatImageFormat( ESCIImageFormat InImageFormat )
+    {
+        return GetCaptureFormat( InImageFormat ) == ESCICaptureFormat::Float16;
+    }
+
+    FORCEINLINE ETextureRenderTargetFormat GetRenderTargetFormat( ESCICaptureFormat InCaptureFormat )
+    {
+        return InCaptureFormat == ESCICaptureFormat::Float16 ? ETextureRenderTargetFormat::RTF_RGBA16f : ETextureRenderTargetFormat::RTF_RGBA8;
+    }
+
+    // The LDR final color is already tonemapped and sRGB encoded, float formats need the linear one.
+    FORCEINLINE ESceneCaptureSource GetCaptureSource( ESCICaptureFormat InCaptureFormat )
+    {
+        return InCaptureFormat == ESCICaptureFormat::Float16 ? ESceneCaptureSource::SCS_FinalColorHDR : ESceneCaptureSource::SCS_FinalColorLDR;
+    }
+
+    FORCEINLINE EPixelFormat GetRenderTargetPixelFormat( ESCICaptureFormat InCaptureFormat )
+    {
+        return InCaptureFormat == ESCICaptureFormat::Float16 ? PF_FloatRGBA : PF_B8G8R8A8;
+    }
+
+    FORCEINLINE int32 GetCaptureBytesPerPixel( ESCICaptureFormat InCaptureFormat )
+    {
+        return InCaptureFormat == ESCICaptureFormat::Float16 ? sizeof( FFloat16Color ) : sizeof( FColor );
+    }
+}
@@ -0,0 +1,20 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+#include "SCIImageFormat.generated.h"
+
+// Every format is backed by an ISCIImageEncoder in FSCIImageEncoderRegistry, which also says
+// what it is captured as and which capture settings it uses.
+UENUM()
+enum class ESCIImageFormat
+{
+    PNG,
+    JPG,
+    EXR,
+    QOI,
+    PNG16,
+    RAW,
+    RAWZ,
+    NPY,
+    NPY16
+};
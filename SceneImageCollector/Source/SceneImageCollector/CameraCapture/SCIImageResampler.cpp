@@ -0,0 +1,186 @@
+#include "SCIImageResampler.h"
+#include "SCIPixelKernels.h"
+
+namespace SCI
+{
+    // Source samples and weights of every output sample along one axis, TapCount per sample.
+    struct FResampleAxis
+    {
+        int32 TapCount = 0;
+        TArray<int32> Indices;
+        TArray<float> Weights;
+    };
+
+    // Shrinking weighs every source sample by how much of the output sample it covers (box
+    // filter), enlarging interpolates bilinearly. Unused taps weigh nothing and read a valid index.
+    void MakeResampleAxis( int32 InSourceSize, int32 InOutputSize, FResampleAxis& OutAxis )
+    {
+        const auto scale = (double)InSourceSize / InOutputSize;
+        OutAxis.TapCount = scale > 1.0 ? FMath::CeilToInt( scale ) + 1 : 2;
+        OutAxis.Indices.SetNumUninitialized( InOutputSize * OutAxis.TapCount );
+        OutAxis.Weights.SetNumZeroed( InOutputSize * OutAxis.TapCount );
+
+        for ( int32 i = 0; i < InOutputSize; i++ ) {
+            auto indices = &OutAxis.Indices[ i * OutAxis.TapCount ];
+            auto weights = &OutAxis.Weights[ i * OutAxis.TapCount ];
+            if ( scale > 1.0 ) {
+                const auto start = i * scale;
+                const auto end   = (i + 1) * scale;
+                const auto first = FMath::FloorToInt( start );
+                for ( int32 t = 0; t < OutAxis.TapCount; t++ ) {
+                    const auto index    = first + t;
+                    const auto coverage = FMath::Min( end, index + 1.0 ) - FMath::Max( start, (double)index );
+                    indices[ t ] = FMath::Min( index, InSourceSize - 1 );
+                    weights[ t ] = index < InSourceSize ? (float)(FMath::Max( coverage, 0.0 ) / scale) : 0.0f;
+                }
+            } else {
+                const auto position = FMath::Clamp( (i + 0.5) * scale - 0.5, 0.0, (double)(InSourceSize - 1) );
+                const auto index    = FMath::FloorToInt( position );
+                indices[ 0 ] = index;
+                indices[ 1 ] = FMath::Min( index + 1, InSourceSize - 1 );
+                weights[ 1 ] = (float)(position - index);
+                weights[ 0 ] = 1.0f - weights[ 1 ];
+            }
+        }
+    }
+
+    // Rows are filtered as interleaved channels, in the pixel's own memory order.
+    FORCEINLINE void LoadResampleRow( const FColor* InPixels, int32 InCount, float* OutChannels )
+    {
+        const auto channels = reinterpret_cast<const uint8*>( InPixels );
+        for ( int32 i = 0; i < InCount * 4; i++ )
+            OutChannels[ i ] = channels[ i ];
+    }
+
+    FORCEINLINE void LoadResampleRow( const FFloat16Color* InPixels, int32 InCount, float* OutChannels )
+    {
+        FSCIPixelKernels::HalfToFloat( &InPixels->R, InCount * 4, OutChannels );
+    }
+
+    // The weights are positive and sum to one, so only float rounding can leave the 8-bit range.
+    FORCEINLINE void StoreResampleRow( const float* InChannels, int32 InCount, FColor* OutPixels )
+    {
+        auto channels = reinterpret_cast<uint8*>( OutPixels );
+        for ( int32 i = 0; i < InCount * 4; i++ )
+            channels[ i ] = (uint8)FMath::Clamp( FMath::RoundToInt( InChannels[ i ] ), 0, 255 );
+    }
+
+    FORCEINLINE void StoreResampleRow( const float* InChannels, int32 InCount, FFloat16Color* OutPixels )
+    {
+        auto channels = &OutPixels->R;
+        for ( int32 i = 0; i < InCount * 4; i++ )
+            channels[ i ] = FFloat16( InChannels[ i ] );
+    }
+
+    // Separable, every source row is filtered horizontally once before the vertical pass.
+    template<typename TPixel>
+    void ResizeSeparable( const TPixel* InPixels, const FIntPoint& InResolution, TPixel* OutPixels, const FIntPoint& InOutputResolution )
+    {
+        FResampleAxis columns;
+        FResampleAxis rows;
+        MakeResampleAxis( InResolution.X, InOutputResolution.X, columns );
+        MakeResampleAxis( InResolution.Y, InOutputResolution.Y, rows );
+
+        const auto outputStride = InOutputResolution.X * 4;
+        TArray<float> source;
+        TArray64<float> filtered;
+        source.SetNumUninitialized( InResolution.X * 4 );
+        filtered.SetNumUninitialized( (int64)InResolution.Y * outputStride );
+
+        for ( int32 y = 0; y < InResolution.Y; y++ ) {
+            LoadResampleRow( InPixels + (int64)y * InResolution.X, InResolution.X, source.GetData() );
+            auto out = &filtered[ (int64)y * outputStride ];
+            for ( int32 x = 0; x < InOutputResolution.X; x++ ) {
+                const auto indices = &columns.Indices[ x * columns.TapCount ];
+                const auto weights = &columns.Weights[ x * columns.TapCount ];
+                float sum[ 4 ] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for ( int32 t = 0; t < columns.TapCount; t++ ) {
+                    const auto in = &source[ indices[ t ] * 4 ];
+                    for ( int32 c = 0; c < 4; c++ )
+                        sum[ c ] += in[ c ] * weights[ t ];
+                }
+                for ( int32 c = 0; c < 4; c++ )
+                    out[ x * 4 + c ] = sum[ c ];
+            }
+        }
+
+        TArray<float> result;
+        result.SetNumUninitialized( outputStride );
+        for ( int32 y = 0; y < InOutputResolution.Y; y++ ) {
+            const auto indices = &rows.Indices[ y * rows.TapCount ];
+            const auto weights = &rows.Weights[ y * rows.TapCount ];
+            FMemory::Memzero( result.GetData(), outputStride * sizeof( float ) );
+            for ( int32 t = 0; t < rows.TapCount; t++ ) {
+                if ( weights[ t ] == 0.0f )
+                    continue;
+
+                const auto in = &filtered[ (int64)indices[ t ] * outputStride ];
+                for ( int32 i = 0; i < outputStride; i++ )
+                    result[ i ] += in[ i ] * weights[ t ];
+            }
+            StoreResampleRow( result.GetData(), InOutputResolution.X, OutPixels + (int64)y * InOutputResolution.X );
+        }
+    }
+
+    // Halved with the 2x2 box kernel while both axes shrink at least that much, the separable
+    // filter handles the remaining scale, so downscaling averages every pixel instead of aliasing.
+    template<typename TPixel>
+    void ResizeImage( const TPixel* InPixels, const FIntPoint& InResolution, TPixel* OutPixels, const FIntPoint& InOutputResolution )
+    {
+        if ( (InOutputResolution.X <= 0) || (InOutputResolution.Y <= 0) )
+            return;
+
+        TArray64<TPixel> halves[ 2 ];
+        auto source     = InPixels;
+        auto resolution = InResolution;
+        for ( int32 i = 0; (resolution.X >= InOutputResolution.X * 2) && (resolution.Y >= InOutputResolution.Y * 2); i ^= 1 ) {
+            const auto half = FSCIImageResampler::GetHalfResolution( resolution );
+            halves[ i ].SetNumUninitialized( (int64)half.X * half.Y );
+            FSCIImageResampler::DownsampleHalf( source, resolution, halves[ i ].GetData() );
+            source     = halves[ i ].GetData();
+            resolution = half;
+        }
+
+        if ( resolution == InOutputResolution )
+            FMemory::Memcpy( OutPixels, source, (int64)resolution.X * resolution.Y * sizeof( TPixel ) );
+        else
+            ResizeSeparable( source, resolution, OutPixels, InOutputResolution );
+    }
+
+    template<typename TPixel>
+    void DownsampleHalfRows( const TPixel* InPixels, const FIntPoint& InResolution, TPixel* OutPixels )
+    {
+        const auto outputResolution = FSCIImageResampler::GetHalfResolution( InResolution );
+        for ( int32 y = 0; y < outputResolution.Y; y++ ) {
+            const auto row0 = InPixels + (int64)y * 2 * InResolution.X;
+            FSCIPixelKernels::BoxDownsample2x( row0, row0 + InResolution.X, outputResolution.X, OutPixels + (int64)y * outputResolution.X );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void FSCIImageResampler::Resize( const FColor* InPixels, const FIntPoint& InResolution, FColor* OutPixels, const FIntPoint& InOutputResolution )
+{
+    SCI::ResizeImage( InPixels, InResolution, OutPixels, InOutputResolution );
+}
+
+void FSCIImageResampler::Resize( const FFloat16Color* InPixels, const FIntPoint& InResolution, FFloat16Color* OutPixels, const FIntPoint& InOutputResolution )
+{
+    SCI::ResizeImage( InPixels, InResolution, OutPixels, InOutputResolution );
+}
+
+FIntPoint FSCIImageResampler::GetHalfResolution( const FIntPoint& InResolution )
+{
+    return FIntPoint( InResolution.X / 2, InResolution.Y / 2 );
+}
+
+void FSCIImageResampler::DownsampleHalf( const FColor* InPixels, const FIntPoint& InResolution, FColor* OutPixels )
+{
+    SCI::DownsampleHalfRows( InPixels, InResolution, OutPixels );
+}
+
+void FSCIImageResampler::DownsampleHalf( const FFloat16Color* InPixels, const FIntPoint& InResolution, FFloat16Color* OutPixels )
+{
+    SCI::DownsampleHalfRows( InPixels, InResolution, OutPixels );
+}
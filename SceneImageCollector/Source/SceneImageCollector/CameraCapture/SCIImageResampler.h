@@ -0,0 +1,17 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+
+// Rescales captured frames on the encoder workers, sample centers aligned. Downscaling is box
+// filtered (2x2 halvings, then area weights), upscaling bilinear.
+class FSCIImageResampler
+{
+public:
+    static void Resize( const FColor* InPixels, const FIntPoint& InResolution, FColor* OutPixels, const FIntPoint& InOutputResolution );
+    static void Resize( const FFloat16Color* InPixels, const FIntPoint& InResolution, FFloat16Color* OutPixels, const FIntPoint& InOutputResolution );
+
+    // 2x2 box filter to half the size, rounded down; an odd last row or column is dropped.
+    static FIntPoint GetHalfResolution( const FIntPoint& InResolution );
+    static void DownsampleHalf( const FColor* InPixels, const FIntPoint& InResolution, FColor* OutPixels );
+    static void DownsampleHalf( const FFloat16Color* InPixels, const FIntPoint& InResolution, FFloat16Color* OutPixels );
+};
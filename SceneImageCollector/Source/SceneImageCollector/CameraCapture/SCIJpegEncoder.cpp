@@ -0,0 +1,162 @@
+#include "SCIJpegEncoder.h"
+#include <Async/ParallelFor.h>
+
+#if WITH_SCI_LIBJPEGTURBO
+THIRD_PARTY_INCLUDES_START
+#include <turbojpeg.h>
+THIRD_PARTY_INCLUDES_END
+#endif
+
+namespace SCI
+{
+#if WITH_SCI_LIBJPEGTURBO
+    constexpr uint8 JPEG_MARKER_SOF0 = 0xC0;
+    constexpr uint8 JPEG_MARKER_RST0 = 0xD0;
+    constexpr uint8 JPEG_MARKER_EOI  = 0xD9;
+    constexpr uint8 JPEG_MARKER_SOS  = 0xDA;
+    constexpr uint8 JPEG_MARKER_DRI  = 0xDD;
+
+    // One strip compressed as a complete jpeg, with the offsets of its frame header and scan.
+    struct FJpegStrip
+    {
+        TArray64<uint8> Data;
+        int64 FrameHeaderOffset = INDEX_NONE;
+        int64 ScanHeaderOffset = INDEX_NONE;
+        int64 ScanOffset = INDEX_NONE;
+    };
+
+    // Every strip is encoded with the same quantization and standard Huffman tables and starts
+    // with zeroed DC predictors, exactly as the decoder expects after a restart marker.
+    bool JpegCompressStrip( const FColor* InPixels, int32 InWidth, int32 InHeight, int32 InSubsampling, int32 InQuality, TArray64<uint8>& OutJpeg )
+    {
+        auto compressor = tjInitCompress();
+        if ( compressor == nullptr )
+            return false;
+
+        // Compressed straight into the array, tjBufSize is the worst case.
+        OutJpeg.SetNumUninitialized( tjBufSize( InWidth, InHeight, InSubsampling ) );
+        auto jpeg     = OutJpeg.GetData();
+        auto jpegSize = (unsigned long)OutJpeg.Num();
+        const auto isCompressed = tjCompress2( compressor, reinterpret_cast<const unsigned char*>( InPixels ), InWidth, InWidth * sizeof( FColor ), InHeight
+        , TJPF_BGRA, &jpeg, &jpegSize, InSubsampling, InQuality, TJFLAG_NOREALLOC ) == 0;
+        tjDestroy( compressor );
+
+        OutJpeg.SetNum( isCompressed ? (int64)jpegSize : 0, false );
+        return isCompressed;
+    }
+
+    // Finds the markers the strips are joined at, the scan runs from ScanOffset up to the EOI.
+    bool JpegParseStrip( FJpegStrip& InOutStrip )
+    {
+        const auto data = InOutStrip.Data.GetData();
+        const auto size = InOutStrip.Data.Num();
+        if ( (size < 4) || (data[ size - 2 ] != 0xFF) || (data[ size - 1 ] != JPEG_MARKER_EOI) )
+            return false;
+
+        // Markers after SOI all carry a big-endian length that includes itself.
+        for ( int64 offset = 2; offset + 4 <= size; ) {
+            if ( data[ offset ] != 0xFF )
+                return false;
+
+            const auto marker = data[ offset + 1 ];
+            const auto length = (data[ offset + 2 ] << 8) | data[ offset + 3 ];
+            if ( marker == JPEG_MARKER_SOF0 )
+                InOutStrip.FrameHeaderOffset = offset;
+
+            if ( marker == JPEG_MARKER_SOS ) {
+                InOutStrip.ScanHeaderOffset = offset;
+                InOutStrip.ScanOffset       = offset + 2 + length;
+                return (InOutStrip.FrameHeaderOffset != INDEX_NONE) && (InOutStrip.ScanOffset <= size - 2);
+            }
+            offset += 2 + length;
+        }
+        return false;
+    }
+
+    void JpegWriteMarker( TArray64<uint8>& OutData, uint8 InMarker )
+    {
+        OutData.Add( 0xFF );
+        OutData.Add( InMarker );
+    }
+#endif
+}
+
+//-----------------------------------------------------------------------------
+
+bool FSCIJpegEncoder::IsAvailable()
+{
+    return WITH_SCI_LIBJPEGTURBO != 0;
+}
+
+bool FSCIJpegEncoder::Encode( const FColor* InPixels, const FIntPoint& InResolution, const FOptions& InOptions, TArray64<uint8>& OutJpeg )
+{
+#if WITH_SCI_LIBJPEGTURBO
+    if ( (InPixels == nullptr) || (InResolution.X <= 0) || (InResolution.Y <= 0) || (InResolution.X > 65535) || (InResolution.Y > 65535) )
+        return false;
+
+    const auto subsampling = InOptions.IsChromaSubsampled ? TJSAMP_420 : TJSAMP_444;
+    const auto quality     = FMath::Clamp( InOptions.Quality, 1, 100 );
+    const auto mcuSize     = InOptions.IsChromaSubsampled ? 16 : 8;
+    const auto mcusPerRow  = FMath::DivideAndRoundUp( InResolution.X, mcuSize );
+    const auto mcuRowCount = FMath::DivideAndRoundUp( InResolution.Y, mcuSize );
+
+    // The restart interval is counted in MCUs and has to fit in 16 bits.
+    auto rowsPerStrip = InOptions.RestartInterval > 0
+    ? InOptions.RestartInterval
+    : FMath::DivideAndRoundUp( mcuRowCount, FPlatformMisc::NumberOfCoresIncludingHyperthreads() );
+    rowsPerStrip = FMath::Clamp( rowsPerStrip, 1, FMath::Max( 65535 / mcusPerRow, 1 ) );
+    const auto stripCount = FMath::DivideAndRoundUp( mcuRowCount, rowsPerStrip );
+
+    if ( stripCount == 1 )
+        return SCI::JpegCompressStrip( InPixels, InResolution.X, InResolution.Y, subsampling, quality, OutJpeg );
+
+    // Every strip but the last is a whole number of MCU rows, so no strip pads rows another one owns.
+    TArray<SCI::FJpegStrip> strips;
+    strips.SetNum( stripCount );
+    TAtomic<bool> isSucceeded( true );
+    ParallelFor( stripCount, [&]( int32 InIndex ){
+        const auto firstLine = InIndex * rowsPerStrip * mcuSize;
+        const auto lineCount = FMath::Min( rowsPerStrip * mcuSize, InResolution.Y - firstLine );
+        auto& strip = strips[ InIndex ];
+        if ( !SCI::JpegCompressStrip( InPixels + (int64)firstLine * InResolution.X, InResolution.X, lineCount, subsampling, quality, strip.Data )
+        || !SCI::JpegParseStrip( strip ) )
+            isSucceeded = false;
+    });
+    if ( !isSucceeded )
+        return false;
+
+    int64 scanSize = 0;
+    for ( const auto& strip : strips )
+        scanSize += strip.Data.Num() - strip.ScanOffset;
+
+    // The first strip's headers describe the whole image once its height is patched and a DRI added.
+    const auto& first = strips[ 0 ];
+    OutJpeg.Reset( first.ScanOffset + 6 + scanSize );
+    OutJpeg.Append( first.Data.GetData(), first.ScanHeaderOffset );
+
+    const auto heightOffset = first.FrameHeaderOffset + 5;
+    OutJpeg[ heightOffset ]     = (uint8)(InResolution.Y >> 8);
+    OutJpeg[ heightOffset + 1 ] = (uint8)InResolution.Y;
+
+    const auto restartInterval = rowsPerStrip * mcusPerRow;
+    SCI::JpegWriteMarker( OutJpeg, SCI::JPEG_MARKER_DRI );
+    OutJpeg.Add( 0 );
+    OutJpeg.Add( 4 );
+    OutJpeg.Add( (uint8)(restartInterval >> 8) );
+    OutJpeg.Add( (uint8)restartInterval );
+
+    OutJpeg.Append( first.Data.GetData() + first.ScanHeaderOffset, first.ScanOffset - first.ScanHeaderOffset );
+    for ( int32 i = 0; i < stripCount; i++ ) {
+        // Each scan ends byte aligned and padded with ones, as the encoder does before a restart marker.
+        const auto& strip = strips[ i ];
+        OutJpeg.Append( strip.Data.GetData() + strip.ScanOffset, strip.Data.Num() - 2 - strip.ScanOffset );
+        if ( i < stripCount - 1 )
+            SCI::JpegWriteMarker( OutJpeg, (uint8)(SCI::JPEG_MARKER_RST0 + (i % 8)) );
+    }
+
+    SCI::JpegWriteMarker( OutJpeg, SCI::JPEG_MARKER_EOI );
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,22 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+
+// Baseline JPEG on the engine's libjpeg-turbo. The frame is cut into restart intervals of whole
+// MCU rows, each interval is compressed on its own core and the scans are joined with RSTn markers.
+// Platforms without libjpeg-turbo have no encoder, callers fall back to ImageWrapper.
+class FSCIJpegEncoder
+{
+public:
+    struct FOptions
+    {
+        int32 Quality = 85;
+        // 4:2:0 when true, 4:4:4 otherwise.
+        bool IsChromaSubsampled = true;
+        // MCU rows per restart interval, 0 picks one interval per core.
+        int32 RestartInterval = 0;
+    };
+
+    static bool IsAvailable();
+    static bool Encode( const FColor* InPixels, const FIntPoint& InResolution, const FOptions& InOptions, TArray64<uint8>& OutJpeg );
+};
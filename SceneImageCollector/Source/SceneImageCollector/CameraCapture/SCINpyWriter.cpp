@@ -0,0 +1,288 @@
+#include "SCINpyWriter.h"
+#include "../VLog.h"
+#include <HAL/PlatformFileManager.h>
+#include <Misc/Paths.h>
+#include <Misc/ScopeLock.h>
+
+#if PLATFORM_WINDOWS
+#include <Windows/AllowWindowsPlatformTypes.h>
+#include <Windows/WindowsHWrapper.h>
+#include <Windows/HideWindowsPlatformTypes.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace SCI
+{
+    constexpr int64 NPY_HEADER_ALIGNMENT = 64;
+    const uint8 NPY_MAGIC[] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0 };
+    // Below the 32-bit size limit of a single WriteFile.
+    constexpr int64 NPY_MAX_WRITE_SIZE = 1ll << 30;
+
+    int64 GetNpyElementSize( FSCINpyWriter::EElementType InElementType )
+    {
+        switch ( InElementType ) {
+            case FSCINpyWriter::EElementType::Float16: return sizeof( FFloat16 );
+            case FSCINpyWriter::EElementType::Float32: return sizeof( float );
+            default:                                   return sizeof( uint8 );
+        }
+    }
+
+    const TCHAR* GetNpyElementDescr( FSCINpyWriter::EElementType InElementType )
+    {
+        switch ( InElementType ) {
+            case FSCINpyWriter::EElementType::Float16: return TEXT( "<f2" );
+            case FSCINpyWriter::EElementType::Float32: return TEXT( "<f4" );
+            default:                                   return TEXT( "|u1" );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+FSCINpyWriter::FSCINpyWriter()
+{
+    ElementType       = EElementType::UInt8;
+    Resolution        = FIntPoint::ZeroValue;
+    ChannelCount      = 0;
+    FrameCapacity     = 0;
+    HeaderSize        = 0;
+    SlotSize          = 0;
+    FrameCount        = 0;
+    DroppedFrameCount = 0;
+#if PLATFORM_WINDOWS
+    File              = INVALID_HANDLE_VALUE;
+#else
+    File              = -1;
+#endif
+}
+
+FSCINpyWriter::~FSCINpyWriter()
+{
+    Close();
+}
+
+bool FSCINpyWriter::Open( const FString& InFilename, EElementType InElementType, const FIntPoint& InResolution, int32 InChannelCount, int64 InFrameCapacity )
+{
+    Close();
+
+    if ( (InResolution.X <= 0) || (InResolution.Y <= 0) || (InChannelCount <= 0) || (InFrameCapacity <= 0) )
+        return false;
+
+    ElementType       = InElementType;
+    Resolution        = InResolution;
+    ChannelCount      = InChannelCount;
+    SlotSize          = (int64)InResolution.X * InResolution.Y * InChannelCount * SCI::GetNpyElementSize( InElementType );
+    FrameCount        = 0;
+    DroppedFrameCount = 0;
+
+    // The capacity has the most digits the shape will ever have, so the fixed-up header fits in the same space.
+    TArray<uint8> header;
+    if ( !MakeHeader( InFrameCapacity, 0, header ) )
+        return false;
+    HeaderSize = header.Num();
+
+    FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree( *FPaths::GetPath( InFilename ) );
+    if ( !OpenFile( InFilename ) || !WriteFileAt( 0, header.GetData(), header.Num() ) || !TruncateFile( HeaderSize + InFrameCapacity * SlotSize ) ) {
+        VLOG( Error, TEXT( "Failed to create npy file: %s" ), *InFilename );
+        CloseFile( false );
+        return false;
+    }
+
+    Filename      = InFilename;
+    FrameCapacity = InFrameCapacity;
+
+    VLOG( Display, TEXT( "Npy file opened: %s (%lld x %d x %d x %d, %.1f MB reserved)" )
+    , *Filename, FrameCapacity, Resolution.Y, Resolution.X, ChannelCount, (HeaderSize + FrameCapacity * SlotSize) / (1024.0 * 1024.0) );
+    return true;
+}
+
+void FSCINpyWriter::Close()
+{
+    if ( !IsOpen() )
+        return;
+
+    // Shape and size shrink to the highest slot written, the header keeps its length.
+    FScopeLock lock( &Mutex );
+    const auto frameCount = FrameCount.Load();
+    TArray<uint8> header;
+    const auto isWritten = MakeHeader( frameCount, HeaderSize, header )
+    && WriteFileAt( 0, header.GetData(), header.Num() )
+    && TruncateFile( HeaderSize + frameCount * SlotSize )
+    && CloseFile( true );
+    // Still open when the fix-up failed.
+    CloseFile( false );
+
+    if ( !isWritten )
+        VLOG( Error, TEXT( "Failed to finalize npy file: %s" ), *Filename );
+    else
+        VLOG( Display, TEXT( "Npy file closed: %s (Frames: %lld, Dropped: %d)" ), *Filename, frameCount, DroppedFrameCount.Load() );
+
+    FrameCapacity = 0;
+}
+
+bool FSCINpyWriter::IsOpen() const
+{
+    return FrameCapacity > 0;
+}
+
+bool FSCINpyWriter::Write( int64 InSlot, const uint8* InData, int64 InSize )
+{
+    if ( (InSlot < 0) || (InSlot >= FrameCapacity) || (InSize != SlotSize) ) {
+        DroppedFrameCount++;
+        return false;
+    }
+
+    if ( !WriteFileAt( HeaderSize + InSlot * SlotSize, InData, InSize ) ) {
+        VLOG( Error, TEXT( "Failed to write npy slot %lld: %s" ), InSlot, *Filename );
+        DroppedFrameCount++;
+        return false;
+    }
+
+    auto frameCount = FrameCount.Load();
+    while ( (frameCount <= InSlot) && !FrameCount.CompareExchange( frameCount, InSlot + 1 ) )
+        ;
+    return true;
+}
+
+FSCINpyWriter::EElementType FSCINpyWriter::GetElementType() const
+{
+    return ElementType;
+}
+
+FIntPoint FSCINpyWriter::GetResolution() const
+{
+    return Resolution;
+}
+
+int32 FSCINpyWriter::GetChannelCount() const
+{
+    return ChannelCount;
+}
+
+int64 FSCINpyWriter::GetSlotSize() const
+{
+    return SlotSize;
+}
+
+bool FSCINpyWriter::MakeHeader( int64 InFrameCount, int64 InHeaderSize, TArray<uint8>& OutHeader ) const
+{
+    // Format 1.0: magic, version, little-endian uint16 length, then a python dict padded with
+    // spaces and a newline so the data starts on a 64 byte boundary.
+    const auto dictionary = FString::Printf( TEXT( "{'descr': '%s', 'fortran_order': False, 'shape': (%lld, %d, %d, %d), }" )
+    , SCI::GetNpyElementDescr( ElementType ), InFrameCount, Resolution.Y, Resolution.X, ChannelCount );
+
+    const auto prefixSize  = (int64)sizeof( SCI::NPY_MAGIC ) + sizeof( uint16 );
+    const auto minimumSize = prefixSize + dictionary.Len() + 1;
+    const auto headerSize  = InHeaderSize > 0 ? InHeaderSize : Align( minimumSize, SCI::NPY_HEADER_ALIGNMENT );
+    if ( (minimumSize > headerSize) || (headerSize - prefixSize > MAX_uint16) )
+        return false;
+
+    OutHeader.Reset( headerSize );
+    OutHeader.Append( SCI::NPY_MAGIC, sizeof( SCI::NPY_MAGIC ) );
+    OutHeader.Add( (uint8)((headerSize - prefixSize) & 0xFF) );
+    OutHeader.Add( (uint8)((headerSize - prefixSize) >> 8) );
+    OutHeader.Append( reinterpret_cast<const uint8*>( TCHAR_TO_ANSI( *dictionary ) ), dictionary.Len() );
+    while ( OutHeader.Num() < headerSize - 1 )
+        OutHeader.Add( ' ' );
+    OutHeader.Add( '\n' );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+#if PLATFORM_WINDOWS
+
+bool FSCINpyWriter::OpenFile( const FString& InFilename )
+{
+    // Readers may map the file while it is being written.
+    const auto fullPath = FPaths::ConvertRelativePathToFull( InFilename );
+    File = CreateFileW( *fullPath, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr );
+    return File != INVALID_HANDLE_VALUE;
+}
+
+bool FSCINpyWriter::WriteFileAt( int64 InOffset, const uint8* InData, int64 InSize ) const
+{
+    // The offset in the OVERLAPPED makes the write positional even on a synchronous handle.
+    while ( InSize > 0 ) {
+        OVERLAPPED overlapped;
+        FMemory::Memzero( overlapped );
+        overlapped.Offset     = (DWORD)(InOffset & 0xFFFFFFFF);
+        overlapped.OffsetHigh = (DWORD)(InOffset >> 32);
+
+        DWORD writtenSize = 0;
+        if ( !::WriteFile( File, InData, (DWORD)FMath::Min( InSize, SCI::NPY_MAX_WRITE_SIZE ), &writtenSize, &overlapped ) || (writtenSize == 0) )
+            return false;
+
+        InOffset += writtenSize;
+        InData   += writtenSize;
+        InSize   -= writtenSize;
+    }
+    return true;
+}
+
+bool FSCINpyWriter::TruncateFile( int64 InSize ) const
+{
+    FILE_END_OF_FILE_INFO endOfFile;
+    endOfFile.EndOfFile.QuadPart = InSize;
+    return SetFileInformationByHandle( File, FileEndOfFileInfo, &endOfFile, sizeof( endOfFile ) ) != 0;
+}
+
+bool FSCINpyWriter::CloseFile( bool InIsFlushed )
+{
+    if ( File == INVALID_HANDLE_VALUE )
+        return !InIsFlushed;
+
+    const auto isFlushed = !InIsFlushed || (FlushFileBuffers( File ) != 0);
+    CloseHandle( File );
+    File = INVALID_HANDLE_VALUE;
+    return isFlushed;
+}
+
+#else
+
+bool FSCINpyWriter::OpenFile( const FString& InFilename )
+{
+    const auto fullPath = FPaths::ConvertRelativePathToFull( InFilename );
+    File = open( TCHAR_TO_UTF8( *fullPath ), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    return File >= 0;
+}
+
+bool FSCINpyWriter::WriteFileAt( int64 InOffset, const uint8* InData, int64 InSize ) const
+{
+    while ( InSize > 0 ) {
+        const auto writtenSize = pwrite( File, InData, (size_t)FMath::Min( InSize, SCI::NPY_MAX_WRITE_SIZE ), (off_t)InOffset );
+        if ( writtenSize < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            return false;
+        }
+        if ( writtenSize == 0 )
+            return false;
+
+        InOffset += writtenSize;
+        InData   += writtenSize;
+        InSize   -= writtenSize;
+    }
+    return true;
+}
+
+bool FSCINpyWriter::TruncateFile( int64 InSize ) const
+{
+    return ftruncate( File, (off_t)InSize ) == 0;
+}
+
+bool FSCINpyWriter::CloseFile( bool InIsFlushed )
+{
+    if ( File < 0 )
+        return !InIsFlushed;
+
+    const auto isFlushed = !InIsFlushed || (fsync( File ) == 0);
+    close( File );
+    File = -1;
+    return isFlushed;
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+
+// NumPy array file of N x H x W x C frames, preallocated for the planned frame count, that
+// every frame is written into at its own slot without decoding anything on the reading side:
+//
+//   numpy.load( "<Actor>.npy", mmap_mode="r" )[ FrameId ]
+//
+// The header is written for the full capacity and fixed up on close to the frames that were
+// actually captured, so an aborted run still loads. Slots nobody wrote stay zero.
+class FSCINpyWriter
+{
+public:
+    enum class EElementType : uint8
+    {
+        UInt8,
+        Float16,
+        Float32
+    };
+
+    FSCINpyWriter();
+    ~FSCINpyWriter();
+
+    bool Open( const FString& InFilename, EElementType InElementType, const FIntPoint& InResolution, int32 InChannelCount, int64 InFrameCapacity );
+    // Only after every writer is done.
+    void Close();
+    bool IsOpen() const;
+
+    // Thread safe and lock free, slots are written in any order through the one handle with
+    // positional writes that never move a shared file pointer.
+    bool Write( int64 InSlot, const uint8* InData, int64 InSize );
+
+    EElementType GetElementType() const;
+    FIntPoint GetResolution() const;
+    int32 GetChannelCount() const;
+    int64 GetSlotSize() const;
+
+private:
+    // Padded to InHeaderSize, or to the next 64 bytes when it is zero.
+    bool MakeHeader( int64 InFrameCount, int64 InHeaderSize, TArray<uint8>& OutHeader ) const;
+
+    bool OpenFile( const FString& InFilename );
+    bool WriteFileAt( int64 InOffset, const uint8* InData, int64 InSize ) const;
+    bool TruncateFile( int64 InSize ) const;
+    bool CloseFile( bool InIsFlushed );
+
+private:
+    // Guards the header fix-up and closing, slot writes do not take it.
+    FCriticalSection Mutex;
+    FString Filename;
+    EElementType ElementType;
+    FIntPoint Resolution;
+    int32 ChannelCount;
+    int64 FrameCapacity;
+    int64 HeaderSize;
+    int64 SlotSize;
+    // Windows does not share a file between write handles, so every slot goes through this one:
+    // a HANDLE written with OVERLAPPED offsets on Windows, a descriptor written with pwrite elsewhere.
+#if PLATFORM_WINDOWS
+    void* File;
+#else
+    int32 File;
+#endif
+    TAtomic<int64> FrameCount;
+    TAtomic<int32> DroppedFrameCount;
+};
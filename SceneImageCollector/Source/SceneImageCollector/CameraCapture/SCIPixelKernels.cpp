@@ -0,0 +1,613 @@
+#include "SCIPixelKernels.h"
+#include "../VLog.h"
+#include <HAL/IConsoleManager.h>
+#include <Math/RandomStream.h>
+#include <Misc/ByteSwap.h>
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+    #define SCI_SIMD_NEON 1
+    #include <arm_neon.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && defined( PLATFORM_ALWAYS_HAS_SSE4_1 ) && PLATFORM_ALWAYS_HAS_SSE4_1
+    #define SCI_SIMD_SSE 1
+    #include <immintrin.h>
+    #if defined( PLATFORM_ALWAYS_HAS_AVX_2 ) && PLATFORM_ALWAYS_HAS_AVX_2
+        #define SCI_SIMD_AVX2 1
+    #endif
+    #if defined( PLATFORM_ALWAYS_HAS_F16C ) && PLATFORM_ALWAYS_HAS_F16C
+        #define SCI_SIMD_F16C 1
+    #endif
+#endif
+
+#ifndef SCI_SIMD_NEON
+    #define SCI_SIMD_NEON 0
+#endif
+#ifndef SCI_SIMD_SSE
+    #define SCI_SIMD_SSE 0
+#endif
+#ifndef SCI_SIMD_AVX2
+    #define SCI_SIMD_AVX2 0
+#endif
+#ifndef SCI_SIMD_F16C
+    #define SCI_SIMD_F16C 0
+#endif
+
+namespace SCI
+{
+    float LinearToSrgb( float InValue )
+    {
+        return InValue <= 0.0031308f ? InValue * 12.92f : 1.055f * FMath::Pow( InValue, 1.0f / 2.4f ) - 0.055f;
+    }
+
+    // Every half in [0, 1] maps to its 16-bit sample, in native byte order. The vector paths
+    // index it with the clamped value converted back to half, which is exact.
+    struct FHalfToUInt16Table
+    {
+        // Half bits of 1.0 are the largest index.
+        static constexpr int32 SIZE = 0x3C00 + 1;
+        uint16 Srgb[ SIZE ];
+        uint16 Linear[ SIZE ];
+
+        FHalfToUInt16Table()
+        {
+            for ( int32 i = 0; i < SIZE; i++ ) {
+                FFloat16 half;
+                half.Encoded = (uint16)i;
+
+                const auto value = half.GetFloat();
+                Srgb[ i ]   = (uint16)FMath::RoundToInt( LinearToSrgb( value ) * 65535.0f );
+                Linear[ i ] = (uint16)FMath::RoundToInt( value * 65535.0f );
+            }
+        }
+
+        // Negative values and NaN end up at zero, everything above one at one.
+        FORCEINLINE static int32 GetIndex( uint16 InHalf )
+        {
+            if ( ((InHalf & 0x8000) != 0) || (InHalf > 0x7C00) )
+                return 0;
+            return FMath::Min<int32>( InHalf, SIZE - 1 );
+        }
+
+        static const FHalfToUInt16Table& Get()
+        {
+            static const FHalfToUInt16Table TABLE;
+            return TABLE;
+        }
+    };
+
+    // Linear [0, 1] in 65536 buckets, each bucket encoded at its center.
+    struct FLinearToSrgb8Table
+    {
+        static constexpr int32 SIZE = 65536;
+        uint8 Values[ SIZE ];
+
+        FLinearToSrgb8Table()
+        {
+            for ( int32 i = 0; i < SIZE; i++ )
+                Values[ i ] = (uint8)FMath::RoundToInt( LinearToSrgb( (i + 0.5f) / SIZE ) * 255.0f );
+        }
+
+        // A single multiply, so the vector and scalar paths cannot round differently.
+        FORCEINLINE static int32 GetIndex( float InValue )
+        {
+            const auto value = InValue > 0.0f ? FMath::Min( InValue, 1.0f ) : 0.0f;
+            return FMath::Min( (int32)(value * (float)SIZE), SIZE - 1 );
+        }
+
+        static const FLinearToSrgb8Table& Get()
+        {
+            static const FLinearToSrgb8Table TABLE;
+            return TABLE;
+        }
+    };
+
+    FORCEINLINE float HalfBitsToFloat( uint16 InHalf )
+    {
+        const uint32 sign     = (uint32)(InHalf & 0x8000) << 16;
+        const uint32 exponent = (InHalf >> 10) & 0x1F;
+        uint32 mantissa       = InHalf & 0x3FF;
+
+        uint32 bits = 0;
+        if ( exponent == 0 ) {
+            if ( mantissa == 0 ) {
+                bits = sign;
+            }
+            else {
+                // Subnormal half, renormalized as a float.
+                uint32 floatExponent = 113;
+                while ( (mantissa & 0x400) == 0 ) {
+                    mantissa <<= 1;
+                    floatExponent--;
+                }
+                bits = sign | (floatExponent << 23) | ((mantissa & 0x3FF) << 13);
+            }
+        }
+        else if ( exponent == 31 ) {
+            // Inf stays inf, NaN is quieted like the hardware conversion does.
+            bits = sign | 0x7F800000 | (mantissa << 13) | (mantissa != 0 ? 0x00400000 : 0);
+        }
+        else {
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+
+        float value;
+        FMemory::Memcpy( &value, &bits, sizeof( float ) );
+        return value;
+    }
+
+    // Round to nearest even, NaN quieted with its payload kept, like the hardware conversion.
+    FORCEINLINE uint16 FloatToHalfBits( float InValue )
+    {
+        uint32 bits;
+        FMemory::Memcpy( &bits, &InValue, sizeof( float ) );
+        const auto sign = (uint16)((bits >> 16) & 0x8000);
+        bits &= 0x7FFFFFFF;
+
+        if ( bits >= 0x7F800000 )
+            return sign | 0x7C00 | (bits > 0x7F800000 ? (0x200 | ((bits >> 13) & 0x3FF)) : 0);
+
+        // 65520 and above round to infinity.
+        if ( bits >= 0x477FF000 )
+            return sign | 0x7C00;
+
+        if ( bits < 0x38800000 ) {
+            // Subnormal half, the float adder does the rounding.
+            constexpr uint32 DENORMAL_MAGIC = 126u << 23;
+            float magic;
+            FMemory::Memcpy( &magic, &DENORMAL_MAGIC, sizeof( float ) );
+            float value;
+            FMemory::Memcpy( &value, &bits, sizeof( float ) );
+            value += magic;
+            FMemory::Memcpy( &bits, &value, sizeof( float ) );
+            return sign | (uint16)(bits - DENORMAL_MAGIC);
+        }
+
+        const auto isMantissaOdd = (bits >> 13) & 1;
+        bits += (uint32)((15 - 127) << 23) + 0xFFF;
+        bits += isMantissaOdd;
+        return sign | (uint16)(bits >> 13);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void FSCIPixelKernels::FScalar::BgraToRgba( const FColor* InPixels, int64 InCount, uint8* OutRgba )
+{
+    for ( int64 i = 0; i < InCount; i++, OutRgba += 4 ) {
+        OutRgba[ 0 ] = InPixels[ i ].R;
+        OutRgba[ 1 ] = InPixels[ i ].G;
+        OutRgba[ 2 ] = InPixels[ i ].B;
+        OutRgba[ 3 ] = InPixels[ i ].A;
+    }
+}
+
+void FSCIPixelKernels::FScalar::BgraToRgb( const FColor* InPixels, int64 InCount, uint8* OutRgb )
+{
+    for ( int64 i = 0; i < InCount; i++, OutRgb += 3 ) {
+        OutRgb[ 0 ] = InPixels[ i ].R;
+        OutRgb[ 1 ] = InPixels[ i ].G;
+        OutRgb[ 2 ] = InPixels[ i ].B;
+    }
+}
+
+void FSCIPixelKernels::FScalar::HalfToFloat( const FFloat16* InHalves, int64 InCount, float* OutFloats )
+{
+    for ( int64 i = 0; i < InCount; i++ )
+        OutFloats[ i ] = SCI::HalfBitsToFloat( InHalves[ i ].Encoded );
+}
+
+void FSCIPixelKernels::FScalar::LinearToSrgb8( const float* InValues, int64 InCount, uint8* OutSrgb )
+{
+    const auto& table = SCI::FLinearToSrgb8Table::Get();
+    for ( int64 i = 0; i < InCount; i++ )
+        OutSrgb[ i ] = table.Values[ SCI::FLinearToSrgb8Table::GetIndex( InValues[ i ] ) ];
+}
+
+void FSCIPixelKernels::FScalar::BoxDownsample2x( const FColor* InRow0, const FColor* InRow1, int64 InOutputCount, FColor* OutRow )
+{
+    for ( int64 i = 0; i < InOutputCount; i++ ) {
+        const auto& a = InRow0[ i * 2 ];
+        const auto& b = InRow0[ i * 2 + 1 ];
+        const auto& c = InRow1[ i * 2 ];
+        const auto& d = InRow1[ i * 2 + 1 ];
+        OutRow[ i ].B = (uint8)((a.B + b.B + c.B + d.B + 2) >> 2);
+        OutRow[ i ].G = (uint8)((a.G + b.G + c.G + d.G + 2) >> 2);
+        OutRow[ i ].R = (uint8)((a.R + b.R + c.R + d.R + 2) >> 2);
+        OutRow[ i ].A = (uint8)((a.A + b.A + c.A + d.A + 2) >> 2);
+    }
+}
+
+void FSCIPixelKernels::FScalar::BoxDownsample2x( const FFloat16Color* InRow0, const FFloat16Color* InRow1, int64 InOutputCount, FFloat16Color* OutRow )
+{
+    const auto* row0 = reinterpret_cast<const uint16*>( InRow0 );
+    const auto* row1 = reinterpret_cast<const uint16*>( InRow1 );
+    auto* out        = reinterpret_cast<uint16*>( OutRow );
+    for ( int64 i = 0; i < InOutputCount; i++ ) {
+        for ( int32 channel = 0; channel < 4; channel++ ) {
+            // Same summation order as the vector paths.
+            const auto a = SCI::HalfBitsToFloat( row0[ i * 8 + channel ] );
+            const auto b = SCI::HalfBitsToFloat( row0[ i * 8 + 4 + channel ] );
+            const auto c = SCI::HalfBitsToFloat( row1[ i * 8 + channel ] );
+            const auto d = SCI::HalfBitsToFloat( row1[ i * 8 + 4 + channel ] );
+            const auto sum = ((a + b) + c) + d;
+            out[ i * 4 + channel ] = SCI::FloatToHalfBits( sum * 0.25f );
+        }
+    }
+}
+
+void FSCIPixelKernels::FScalar::HalfToSrgb16BigEndian( const FFloat16Color* InPixels, int64 InCount, uint16* OutSamples )
+{
+    const auto& table = SCI::FHalfToUInt16Table::Get();
+    for ( int64 i = 0; i < InCount; i++, OutSamples += 4 ) {
+        const auto& pixel = InPixels[ i ];
+        OutSamples[ 0 ] = NETWORK_ORDER16( table.Srgb[ SCI::FHalfToUInt16Table::GetIndex( pixel.R.Encoded ) ] );
+        OutSamples[ 1 ] = NETWORK_ORDER16( table.Srgb[ SCI::FHalfToUInt16Table::GetIndex( pixel.G.Encoded ) ] );
+        OutSamples[ 2 ] = NETWORK_ORDER16( table.Srgb[ SCI::FHalfToUInt16Table::GetIndex( pixel.B.Encoded ) ] );
+        OutSamples[ 3 ] = NETWORK_ORDER16( table.Linear[ SCI::FHalfToUInt16Table::GetIndex( pixel.A.Encoded ) ] );
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void FSCIPixelKernels::BgraToRgba( const FColor* InPixels, int64 InCount, uint8* OutRgba )
+{
+    int64 i = 0;
+#if SCI_SIMD_AVX2
+    const auto mask256 = _mm256_setr_epi8( 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15 );
+    for ( ; i + 8 <= InCount; i += 8 ) {
+        const auto pixels = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( InPixels + i ) );
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>( OutRgba + i * 4 ), _mm256_shuffle_epi8( pixels, mask256 ) );
+    }
+#endif
+#if SCI_SIMD_SSE
+    const auto mask = _mm_setr_epi8( 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15 );
+    for ( ; i + 4 <= InCount; i += 4 ) {
+        const auto pixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>( InPixels + i ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( OutRgba + i * 4 ), _mm_shuffle_epi8( pixels, mask ) );
+    }
+#elif SCI_SIMD_NEON
+    for ( ; i + 16 <= InCount; i += 16 ) {
+        auto planes = vld4q_u8( reinterpret_cast<const uint8*>( InPixels + i ) );
+        const auto blue = planes.val[ 0 ];
+        planes.val[ 0 ] = planes.val[ 2 ];
+        planes.val[ 2 ] = blue;
+        vst4q_u8( OutRgba + i * 4, planes );
+    }
+#endif
+    FScalar::BgraToRgba( InPixels + i, InCount - i, OutRgba + i * 4 );
+}
+
+void FSCIPixelKernels::BgraToRgb( const FColor* InPixels, int64 InCount, uint8* OutRgb )
+{
+    int64 i = 0;
+#if SCI_SIMD_SSE
+    // Stores 16 bytes but advances 12, so stop while the spare bytes still land inside the output.
+    const auto mask = _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 );
+    for ( ; i + 6 <= InCount; i += 4 ) {
+        const auto pixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>( InPixels + i ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( OutRgb + i * 3 ), _mm_shuffle_epi8( pixels, mask ) );
+    }
+#elif SCI_SIMD_NEON
+    for ( ; i + 16 <= InCount; i += 16 ) {
+        const auto planes = vld4q_u8( reinterpret_cast<const uint8*>( InPixels + i ) );
+        uint8x16x3_t rgb;
+        rgb.val[ 0 ] = planes.val[ 2 ];
+        rgb.val[ 1 ] = planes.val[ 1 ];
+        rgb.val[ 2 ] = planes.val[ 0 ];
+        vst3q_u8( OutRgb + i * 3, rgb );
+    }
+#endif
+    FScalar::BgraToRgb( InPixels + i, InCount - i, OutRgb + i * 3 );
+}
+
+void FSCIPixelKernels::HalfToFloat( const FFloat16* InHalves, int64 InCount, float* OutFloats )
+{
+    int64 i = 0;
+#if SCI_SIMD_F16C && SCI_SIMD_AVX2
+    for ( ; i + 8 <= InCount; i += 8 ) {
+        const auto halves = _mm_loadu_si128( reinterpret_cast<const __m128i*>( InHalves + i ) );
+        _mm256_storeu_ps( OutFloats + i, _mm256_cvtph_ps( halves ) );
+    }
+#endif
+#if SCI_SIMD_F16C
+    for ( ; i + 4 <= InCount; i += 4 ) {
+        const auto halves = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( InHalves + i ) );
+        _mm_storeu_ps( OutFloats + i, _mm_cvtph_ps( halves ) );
+    }
+#elif SCI_SIMD_NEON
+    for ( ; i + 4 <= InCount; i += 4 ) {
+        const auto halves = vld1_u16( reinterpret_cast<const uint16*>( InHalves + i ) );
+        vst1q_f32( OutFloats + i, vcvt_f32_f16( vreinterpret_f16_u16( halves ) ) );
+    }
+#endif
+    FScalar::HalfToFloat( InHalves + i, InCount - i, OutFloats + i );
+}
+
+void FSCIPixelKernels::LinearToSrgb8( const float* InValues, int64 InCount, uint8* OutSrgb )
+{
+    int64 i = 0;
+#if SCI_SIMD_SSE || SCI_SIMD_NEON
+    const auto& table = SCI::FLinearToSrgb8Table::Get();
+    alignas( 16 ) int32 indices[ 4 ];
+#endif
+#if SCI_SIMD_SSE
+    // max( x, 0 ) returns the second operand for NaN, matching the scalar clamp.
+    const auto zero  = _mm_setzero_ps();
+    const auto one   = _mm_set1_ps( 1.0f );
+    const auto scale = _mm_set1_ps( (float)SCI::FLinearToSrgb8Table::SIZE );
+    const auto last  = _mm_set1_epi32( SCI::FLinearToSrgb8Table::SIZE - 1 );
+    for ( ; i + 4 <= InCount; i += 4 ) {
+        const auto values = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( InValues + i ), zero ), one );
+        _mm_store_si128( reinterpret_cast<__m128i*>( indices ), _mm_min_epi32( _mm_cvttps_epi32( _mm_mul_ps( values, scale ) ), last ) );
+        OutSrgb[ i + 0 ] = table.Values[ indices[ 0 ] ];
+        OutSrgb[ i + 1 ] = table.Values[ indices[ 1 ] ];
+        OutSrgb[ i + 2 ] = table.Values[ indices[ 2 ] ];
+        OutSrgb[ i + 3 ] = table.Values[ indices[ 3 ] ];
+    }
+#elif SCI_SIMD_NEON
+    // vmaxnm picks the number over NaN, matching the scalar clamp.
+    const auto zero  = vdupq_n_f32( 0.0f );
+    const auto one   = vdupq_n_f32( 1.0f );
+    const auto scale = vdupq_n_f32( (float)SCI::FLinearToSrgb8Table::SIZE );
+    const auto last  = vdupq_n_s32( SCI::FLinearToSrgb8Table::SIZE - 1 );
+    for ( ; i + 4 <= InCount; i += 4 ) {
+        const auto values = vminq_f32( vmaxnmq_f32( vld1q_f32( InValues + i ), zero ), one );
+        vst1q_s32( indices, vminq_s32( vcvtq_s32_f32( vmulq_f32( values, scale ) ), last ) );
+        OutSrgb[ i + 0 ] = table.Values[ indices[ 0 ] ];
+        OutSrgb[ i + 1 ] = table.Values[ indices[ 1 ] ];
+        OutSrgb[ i + 2 ] = table.Values[ indices[ 2 ] ];
+        OutSrgb[ i + 3 ] = table.Values[ indices[ 3 ] ];
+    }
+#endif
+    FScalar::LinearToSrgb8( InValues + i, InCount - i, OutSrgb + i );
+}
+
+void FSCIPixelKernels::BoxDownsample2x( const FColor* InRow0, const FColor* InRow1, int64 InOutputCount, FColor* OutRow )
+{
+    int64 i = 0;
+#if SCI_SIMD_SSE
+    // Four source pixels per row make two output pixels, summed in 16 bits.
+    const auto zero     = _mm_setzero_si128();
+    const auto rounding = _mm_set1_epi16( 2 );
+    for ( ; i + 2 <= InOutputCount; i += 2 ) {
+        const auto top    = _mm_loadu_si128( reinterpret_cast<const __m128i*>( InRow0 + i * 2 ) );
+        const auto bottom = _mm_loadu_si128( reinterpret_cast<const __m128i*>( InRow1 + i * 2 ) );
+        const auto low    = _mm_add_epi16( _mm_unpacklo_epi8( top, zero ), _mm_unpacklo_epi8( bottom, zero ) );
+        const auto high   = _mm_add_epi16( _mm_unpackhi_epi8( top, zero ), _mm_unpackhi_epi8( bottom, zero ) );
+        const auto pairs  = _mm_unpacklo_epi64( _mm_add_epi16( low, _mm_srli_si128( low, 8 ) ), _mm_add_epi16( high, _mm_srli_si128( high, 8 ) ) );
+        const auto result = _mm_srli_epi16( _mm_add_epi16( pairs, rounding ), 2 );
+        _mm_storel_epi64( reinterpret_cast<__m128i*>( OutRow + i ), _mm_packus_epi16( result, zero ) );
+    }
+#elif SCI_SIMD_NEON
+    for ( ; i + 8 <= InOutputCount; i += 8 ) {
+        const auto top    = vld4q_u8( reinterpret_cast<const uint8*>( InRow0 + i * 2 ) );
+        const auto bottom = vld4q_u8( reinterpret_cast<const uint8*>( InRow1 + i * 2 ) );
+        uint8x8x4_t result;
+        for ( int32 channel = 0; channel < 4; channel++ ) {
+            // Pairwise widening add per row, then a rounding narrow by four.
+            const auto sum = vaddq_u16( vpaddlq_u8( top.val[ channel ] ), vpaddlq_u8( bottom.val[ channel ] ) );
+            result.val[ channel ] = vrshrn_n_u16( sum, 2 );
+        }
+        vst4_u8( reinterpret_cast<uint8*>( OutRow + i ), result );
+    }
+#endif
+    FScalar::BoxDownsample2x( InRow0 + i * 2, InRow1 + i * 2, InOutputCount - i, OutRow + i );
+}
+
+void FSCIPixelKernels::BoxDownsample2x( const FFloat16Color* InRow0, const FFloat16Color* InRow1, int64 InOutputCount, FFloat16Color* OutRow )
+{
+    int64 i = 0;
+#if SCI_SIMD_F16C
+    const auto quarter = _mm_set1_ps( 0.25f );
+    for ( ; i < InOutputCount; i++ ) {
+        const auto a = _mm_cvtph_ps( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( InRow0 + i * 2 ) ) );
+        const auto b = _mm_cvtph_ps( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( InRow0 + i * 2 + 1 ) ) );
+        const auto c = _mm_cvtph_ps( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( InRow1 + i * 2 ) ) );
+        const auto d = _mm_cvtph_ps( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( InRow1 + i * 2 + 1 ) ) );
+        const auto sum = _mm_add_ps( _mm_add_ps( _mm_add_ps( a, b ), c ), d );
+        _mm_storel_epi64( reinterpret_cast<__m128i*>( OutRow + i ), _mm_cvtps_ph( _mm_mul_ps( sum, quarter ), _MM_FROUND_TO_NEAREST_INT ) );
+    }
+#elif SCI_SIMD_NEON
+    const auto quarter = vdupq_n_f32( 0.25f );
+    for ( ; i < InOutputCount; i++ ) {
+        const auto a = vcvt_f32_f16( vreinterpret_f16_u16( vld1_u16( reinterpret_cast<const uint16*>( InRow0 + i * 2 ) ) ) );
+        const auto b = vcvt_f32_f16( vreinterpret_f16_u16( vld1_u16( reinterpret_cast<const uint16*>( InRow0 + i * 2 + 1 ) ) ) );
+        const auto c = vcvt_f32_f16( vreinterpret_f16_u16( vld1_u16( reinterpret_cast<const uint16*>( InRow1 + i * 2 ) ) ) );
+        const auto d = vcvt_f32_f16( vreinterpret_f16_u16( vld1_u16( reinterpret_cast<const uint16*>( InRow1 + i * 2 + 1 ) ) ) );
+        const auto sum = vaddq_f32( vaddq_f32( vaddq_f32( a, b ), c ), d );
+        vst1_u16( reinterpret_cast<uint16*>( OutRow + i ), vreinterpret_u16_f16( vcvt_f16_f32( vmulq_f32( sum, quarter ) ) ) );
+    }
+#endif
+    FScalar::BoxDownsample2x( InRow0 + i * 2, InRow1 + i * 2, InOutputCount - i, OutRow + i );
+}
+
+void FSCIPixelKernels::HalfToSrgb16BigEndian( const FFloat16Color* InPixels, int64 InCount, uint16* OutSamples )
+{
+    int64 i = 0;
+#if SCI_SIMD_F16C || SCI_SIMD_NEON
+    // Two pixels per step: convert, clamp, back to half for the sRGB table index, alpha scaled
+    // and rounded like RoundToInt, then every sample byte swapped.
+    const auto& table = SCI::FHalfToUInt16Table::Get();
+    alignas( 16 ) uint16 indices[ 8 ];
+#endif
+#if SCI_SIMD_F16C
+    // max( x, 0 ) returns the second operand for NaN and -0, so both end up at +0.
+    const auto zero     = _mm_setzero_ps();
+    const auto one      = _mm_set1_ps( 1.0f );
+    const auto scale    = _mm_set1_ps( 65535.0f );
+    const auto rounding = _mm_set1_ps( 0.5f );
+    const auto swap     = _mm_setr_epi8( 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 );
+    for ( ; i + 2 <= InCount; i += 2 ) {
+        const auto halves = _mm_loadu_si128( reinterpret_cast<const __m128i*>( InPixels + i ) );
+        const auto low    = _mm_min_ps( _mm_max_ps( _mm_cvtph_ps( halves ), zero ), one );
+        const auto high   = _mm_min_ps( _mm_max_ps( _mm_cvtph_ps( _mm_unpackhi_epi64( halves, halves ) ), zero ), one );
+        _mm_store_si128( reinterpret_cast<__m128i*>( indices ), _mm_unpacklo_epi64( _mm_cvtps_ph( low, _MM_FROUND_TO_NEAREST_INT ), _mm_cvtps_ph( high, _MM_FROUND_TO_NEAREST_INT ) ) );
+
+        const auto lowLinear  = _mm_cvttps_epi32( _mm_floor_ps( _mm_add_ps( _mm_mul_ps( low, scale ), rounding ) ) );
+        const auto highLinear = _mm_cvttps_epi32( _mm_floor_ps( _mm_add_ps( _mm_mul_ps( high, scale ), rounding ) ) );
+        const auto linear     = _mm_packus_epi32( lowLinear, highLinear );
+        const auto srgb       = _mm_setr_epi16( table.Srgb[ indices[ 0 ] ], table.Srgb[ indices[ 1 ] ], table.Srgb[ indices[ 2 ] ], 0
+        , table.Srgb[ indices[ 4 ] ], table.Srgb[ indices[ 5 ] ], table.Srgb[ indices[ 6 ] ], 0 );
+
+        // Alpha is the last of every four samples.
+        const auto samples = _mm_blend_epi16( srgb, linear, 0x88 );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( OutSamples + i * 4 ), _mm_shuffle_epi8( samples, swap ) );
+    }
+#elif SCI_SIMD_NEON
+    // vmaxnm picks the number over NaN and +0 over -0.
+    const auto zero      = vdupq_n_f32( 0.0f );
+    const auto one       = vdupq_n_f32( 1.0f );
+    const auto scale     = vdupq_n_f32( 65535.0f );
+    const auto rounding  = vdupq_n_f32( 0.5f );
+    const uint16 ALPHA_LANES[ 8 ] = { 0, 0, 0, 0xFFFF, 0, 0, 0, 0xFFFF };
+    const auto alphaMask = vld1q_u16( ALPHA_LANES );
+    for ( ; i + 2 <= InCount; i += 2 ) {
+        const auto halves = vld1q_u16( reinterpret_cast<const uint16*>( InPixels + i ) );
+        const auto low    = vminq_f32( vmaxnmq_f32( vcvt_f32_f16( vreinterpret_f16_u16( vget_low_u16( halves ) ) ), zero ), one );
+        const auto high   = vminq_f32( vmaxnmq_f32( vcvt_f32_f16( vreinterpret_f16_u16( vget_high_u16( halves ) ) ), zero ), one );
+        vst1q_u16( indices, vcombine_u16( vreinterpret_u16_f16( vcvt_f16_f32( low ) ), vreinterpret_u16_f16( vcvt_f16_f32( high ) ) ) );
+
+        const auto lowLinear  = vcvtq_u32_f32( vrndmq_f32( vaddq_f32( vmulq_f32( low, scale ), rounding ) ) );
+        const auto highLinear = vcvtq_u32_f32( vrndmq_f32( vaddq_f32( vmulq_f32( high, scale ), rounding ) ) );
+        const auto linear     = vcombine_u16( vmovn_u32( lowLinear ), vmovn_u32( highLinear ) );
+        const uint16 srgbSamples[ 8 ] = { table.Srgb[ indices[ 0 ] ], table.Srgb[ indices[ 1 ] ], table.Srgb[ indices[ 2 ] ], 0
+        , table.Srgb[ indices[ 4 ] ], table.Srgb[ indices[ 5 ] ], table.Srgb[ indices[ 6 ] ], 0 };
+
+        const auto samples = vbslq_u16( alphaMask, linear, vld1q_u16( srgbSamples ) );
+        vst1q_u16( OutSamples + i * 4, vreinterpretq_u16_u8( vrev16q_u8( vreinterpretq_u8_u16( samples ) ) ) );
+    }
+#endif
+    FScalar::HalfToSrgb16BigEndian( InPixels + i, InCount - i, OutSamples + i * 4 );
+}
+
+void FSCIPixelKernels::TonemapToSrgb8( const FFloat16Color* InPixels, int64 InCount, float InExposure, FColor* OutPixels )
+{
+    // Chunks small enough to stay in L1 between the kernels.
+    constexpr int32 CHUNK_PIXELS = 256;
+    float linear[ CHUNK_PIXELS * 4 ];
+    uint8 srgb[ CHUNK_PIXELS * 4 ];
+
+    for ( int64 start = 0; start < InCount; start += CHUNK_PIXELS ) {
+        const auto count = (int32)FMath::Min<int64>( CHUNK_PIXELS, InCount - start );
+        HalfToFloat( &InPixels[ start ].R, count * 4, linear );
+        for ( int32 i = 0; i < count * 4; i++ )
+            linear[ i ] *= InExposure;
+        LinearToSrgb8( linear, count * 4, srgb );
+
+        auto out = OutPixels + start;
+        for ( int32 i = 0; i < count; i++ )
+            out[ i ] = FColor( srgb[ i * 4 + 0 ], srgb[ i * 4 + 1 ], srgb[ i * 4 + 2 ], 255 );
+    }
+}
+
+const TCHAR* FSCIPixelKernels::GetInstructionSetName()
+{
+#if SCI_SIMD_NEON
+    return TEXT( "NEON" );
+#elif SCI_SIMD_AVX2
+    return SCI_SIMD_F16C ? TEXT( "AVX2+F16C" ) : TEXT( "AVX2" );
+#elif SCI_SIMD_SSE
+    return SCI_SIMD_F16C ? TEXT( "SSE4.1+F16C" ) : TEXT( "SSE4.1" );
+#else
+    return TEXT( "Scalar" );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+
+static FAutoConsoleCommand GSCIVerifyPixelKernelsCommand(
+    TEXT( "SCI.VerifyPixelKernels" ),
+    TEXT( "Checks the vector pixel kernels against their scalar references. Usage: SCI.VerifyPixelKernels [PixelCount]" ),
+    FConsoleCommandWithArgsDelegate::CreateLambda( []( const TArray<FString>& InArgs ){
+        // An odd count exercises the scalar tails as well.
+        const auto count = InArgs.IsValidIndex( 0 ) ? FMath::Max( FCString::Atoi( *InArgs[ 0 ] ), 1 ) : 4099;
+
+        FRandomStream random( 1234 );
+        TArray<FColor> pixels;
+        pixels.SetNumUninitialized( count );
+        for ( auto& pixel : pixels )
+            pixel = FColor( (uint32)random.GetUnsignedInt() );
+
+        // Every half bit pattern, including subnormals, infinities and NaNs.
+        TArray<FFloat16> halves;
+        halves.SetNumUninitialized( 65536 + count );
+        for ( int32 i = 0; i < halves.Num(); i++ )
+            halves[ i ].Encoded = (uint16)(i < 65536 ? i : random.GetUnsignedInt());
+
+        TArray<float> floats;
+        floats.SetNumUninitialized( count + 6 );
+        for ( int32 i = 0; i < count; i++ )
+            floats[ i ] = random.FRandRange( -0.25f, 1.25f );
+        floats[ count + 0 ] = 0.0f;
+        floats[ count + 1 ] = 1.0f;
+        floats[ count + 2 ] = -0.0f;
+        floats[ count + 3 ] = FLT_MAX;
+        floats[ count + 4 ] = -FLT_MAX;
+        floats[ count + 5 ] = FMath::Sqrt( -1.0f );
+
+        auto verify = []( const TCHAR* InName, const TArray64<uint8>& InVector, const TArray64<uint8>& InScalar ){
+            const auto isMatched = (InVector.Num() == InScalar.Num()) && (FMemory::Memcmp( InVector.GetData(), InScalar.GetData(), InVector.Num() ) == 0);
+            VLOG( Display, TEXT( "%s: %s" ), InName, isMatched ? TEXT( "OK" ) : TEXT( "MISMATCH" ) );
+            return isMatched;
+        };
+
+        TArray64<uint8> vectorResult;
+        TArray64<uint8> scalarResult;
+        auto isAllMatched = true;
+
+        vectorResult.SetNumZeroed( (int64)count * 4 );
+        scalarResult.SetNumZeroed( (int64)count * 4 );
+        FSCIPixelKernels::BgraToRgba( pixels.GetData(), count, vectorResult.GetData() );
+        FSCIPixelKernels::FScalar::BgraToRgba( pixels.GetData(), count, scalarResult.GetData() );
+        isAllMatched &= verify( TEXT( "BgraToRgba" ), vectorResult, scalarResult );
+
+        vectorResult.SetNumZeroed( (int64)count * 3 );
+        scalarResult.SetNumZeroed( (int64)count * 3 );
+        FSCIPixelKernels::BgraToRgb( pixels.GetData(), count, vectorResult.GetData() );
+        FSCIPixelKernels::FScalar::BgraToRgb( pixels.GetData(), count, scalarResult.GetData() );
+        isAllMatched &= verify( TEXT( "BgraToRgb" ), vectorResult, scalarResult );
+
+        vectorResult.SetNumZeroed( (int64)halves.Num() * sizeof( float ) );
+        scalarResult.SetNumZeroed( (int64)halves.Num() * sizeof( float ) );
+        FSCIPixelKernels::HalfToFloat( halves.GetData(), halves.Num(), reinterpret_cast<float*>( vectorResult.GetData() ) );
+        FSCIPixelKernels::FScalar::HalfToFloat( halves.GetData(), halves.Num(), reinterpret_cast<float*>( scalarResult.GetData() ) );
+        isAllMatched &= verify( TEXT( "HalfToFloat" ), vectorResult, scalarResult );
+
+        vectorResult.SetNumZeroed( floats.Num() );
+        scalarResult.SetNumZeroed( floats.Num() );
+        FSCIPixelKernels::LinearToSrgb8( floats.GetData(), floats.Num(), vectorResult.GetData() );
+        FSCIPixelKernels::FScalar::LinearToSrgb8( floats.GetData(), floats.Num(), scalarResult.GetData() );
+        isAllMatched &= verify( TEXT( "LinearToSrgb8" ), vectorResult, scalarResult );
+
+        // Two source rows side by side, one pixel short so the scalar tails run as well.
+        const auto outputCount = FMath::Max( count / 4 - 1, 0 );
+        TArray<FColor> downsampled;
+        TArray<FColor> scalarDownsampled;
+        downsampled.SetNumZeroed( outputCount );
+        scalarDownsampled.SetNumZeroed( outputCount );
+        FSCIPixelKernels::BoxDownsample2x( pixels.GetData(), pixels.GetData() + outputCount * 2, outputCount, downsampled.GetData() );
+        FSCIPixelKernels::FScalar::BoxDownsample2x( pixels.GetData(), pixels.GetData() + outputCount * 2, outputCount, scalarDownsampled.GetData() );
+        vectorResult.SetNumUninitialized( outputCount * sizeof( FColor ) );
+        scalarResult.SetNumUninitialized( outputCount * sizeof( FColor ) );
+        FMemory::Memcpy( vectorResult.GetData(), downsampled.GetData(), vectorResult.Num() );
+        FMemory::Memcpy( scalarResult.GetData(), scalarDownsampled.GetData(), scalarResult.Num() );
+        isAllMatched &= verify( TEXT( "BoxDownsample2x (8-bit)" ), vectorResult, scalarResult );
+
+        // The half rows reuse every bit pattern, NaNs and infinities included.
+        const auto halfPixels      = reinterpret_cast<const FFloat16Color*>( halves.GetData() );
+        const auto halfOutputCount = halves.Num() / 16;
+        vectorResult.SetNumZeroed( halfOutputCount * sizeof( FFloat16Color ) );
+        scalarResult.SetNumZeroed( halfOutputCount * sizeof( FFloat16Color ) );
+        FSCIPixelKernels::BoxDownsample2x( halfPixels, halfPixels + halfOutputCount * 2, halfOutputCount, reinterpret_cast<FFloat16Color*>( vectorResult.GetData() ) );
+        FSCIPixelKernels::FScalar::BoxDownsample2x( halfPixels, halfPixels + halfOutputCount * 2, halfOutputCount, reinterpret_cast<FFloat16Color*>( scalarResult.GetData() ) );
+        isAllMatched &= verify( TEXT( "BoxDownsample2x (half)" ), vectorResult, scalarResult );
+
+        const auto halfPixelCount = halves.Num() / 4;
+        vectorResult.SetNumZeroed( halfPixelCount * sizeof( FFloat16Color ) );
+        scalarResult.SetNumZeroed( halfPixelCount * sizeof( FFloat16Color ) );
+        FSCIPixelKernels::HalfToSrgb16BigEndian( halfPixels, halfPixelCount, reinterpret_cast<uint16*>( vectorResult.GetData() ) );
+        FSCIPixelKernels::FScalar::HalfToSrgb16BigEndian( halfPixels, halfPixelCount, reinterpret_cast<uint16*>( scalarResult.GetData() ) );
+        isAllMatched &= verify( TEXT( "HalfToSrgb16BigEndian" ), vectorResult, scalarResult );
+
+        VLOG( Display, TEXT( "Pixel kernels (%s): %s" ), FSCIPixelKernels::GetInstructionSetName(), isAllMatched ? TEXT( "all match" ) : TEXT( "FAILED" ) );
+    })
+);
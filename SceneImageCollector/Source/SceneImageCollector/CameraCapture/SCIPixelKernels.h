@@ -0,0 +1,43 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+
+// Per-pixel conversions on the encoder workers. Every kernel has an SSE/AVX2 or NEON path
+// picked at compile time, the half-float ones need F16C on x64, and a scalar path that
+// handles the tail and defines the result.
+// The SCI.PixelKernels automation tests check known answers, SCI.VerifyPixelKernels checks
+// that both paths agree bit for bit on random input.
+class FSCIPixelKernels
+{
+public:
+    static void BgraToRgba( const FColor* InPixels, int64 InCount, uint8* OutRgba );
+    static void BgraToRgb( const FColor* InPixels, int64 InCount, uint8* OutRgb );
+    static void HalfToFloat( const FFloat16* InHalves, int64 InCount, float* OutFloats );
+    // Clamps to [0, 1] and sRGB encodes through a 64K entry table.
+    static void LinearToSrgb8( const float* InValues, int64 InCount, uint8* OutSrgb );
+
+    // One output row of a 2x2 box filter, reading 2 * InOutputCount pixels from both rows.
+    static void BoxDownsample2x( const FColor* InRow0, const FColor* InRow1, int64 InOutputCount, FColor* OutRow );
+    static void BoxDownsample2x( const FFloat16Color* InRow0, const FFloat16Color* InRow1, int64 InOutputCount, FFloat16Color* OutRow );
+
+    // Half-float RGBA to big-endian RGBA16 for png. Color is clamped and sRGB encoded through
+    // a table indexed by the clamped half, alpha stays linear.
+    static void HalfToSrgb16BigEndian( const FFloat16Color* InPixels, int64 InCount, uint16* OutSamples );
+
+    // Exposure scaled, clamped, sRGB encoded 8-bit preview with opaque alpha.
+    static void TonemapToSrgb8( const FFloat16Color* InPixels, int64 InCount, float InExposure, FColor* OutPixels );
+
+    static const TCHAR* GetInstructionSetName();
+
+    // Reference implementations.
+    struct FScalar
+    {
+        static void BgraToRgba( const FColor* InPixels, int64 InCount, uint8* OutRgba );
+        static void BgraToRgb( const FColor* InPixels, int64 InCount, uint8* OutRgb );
+        static void HalfToFloat( const FFloat16* InHalves, int64 InCount, float* OutFloats );
+        static void LinearToSrgb8( const float* InValues, int64 InCount, uint8* OutSrgb );
+        static void BoxDownsample2x( const FColor* InRow0, const FColor* InRow1, int64 InOutputCount, FColor* OutRow );
+        static void BoxDownsample2x( const FFloat16Color* InRow0, const FFloat16Color* InRow1, int64 InOutputCount, FFloat16Color* OutRow );
+        static void HalfToSrgb16BigEndian( const FFloat16Color* InPixels, int64 InCount, uint16* OutSamples );
+    };
+};
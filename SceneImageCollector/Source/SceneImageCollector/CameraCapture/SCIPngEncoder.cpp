@@ -0,0 +1,307 @@
+#include "SCIPngEncoder.h"
+#include "SCIPixelKernels.h"
+#include "../VLog.h"
+#include <Async/ParallelFor.h>
+#include <HAL/IConsoleManager.h>
+#include <Math/RandomStream.h>
+#include <Modules/ModuleManager.h>
+#include <ImageWrapper/Public/IImageWrapper.h>
+#include <ImageWrapper/Public/IImageWrapperModule.h>
+THIRD_PARTY_INCLUDES_START
+#include <zlib.h>
+THIRD_PARTY_INCLUDES_END
+
+namespace SCI
+{
+    constexpr int32 PNG_MIN_BAND_ROWS   = 32;
+    constexpr int32 DEFLATE_WINDOW_SIZE = 32 * 1024;
+
+    struct FPngBand
+    {
+        int32 FirstRow = 0;
+        int32 RowCount = 0;
+        TArray64<uint8> Filtered;
+        TArray64<uint8> Compressed;
+        uLong Adler = 1;
+        bool IsSucceeded = false;
+    };
+
+    void WriteBigEndian32( TArray64<uint8>& OutData, uint32 InValue )
+    {
+        OutData.Add( (uint8)(InValue >> 24) );
+        OutData.Add( (uint8)(InValue >> 16) );
+        OutData.Add( (uint8)(InValue >> 8) );
+        OutData.Add( (uint8)InValue );
+    }
+
+    void WriteChunk( TArray64<uint8>& OutData, const char* InType, const uint8* InPayload, int64 InSize )
+    {
+        WriteBigEndian32( OutData, (uint32)InSize );
+        const auto typeOffset = OutData.Num();
+        OutData.Append( reinterpret_cast<const uint8*>( InType ), 4 );
+        if ( InSize > 0 )
+            OutData.Append( InPayload, InSize );
+
+        // CRC covers the chunk type and the payload.
+        const auto crc = crc32( 0L, OutData.GetData() + typeOffset, (uInt)(InSize + 4) );
+        WriteBigEndian32( OutData, (uint32)crc );
+    }
+
+    int32 GetBytesPerPixel( const FSCIPngEncoder::FSource& InSource )
+    {
+        return InSource.BitDepth == 16 ? 8 : 4;
+    }
+
+    uint8 PaethPredictor( int32 InLeft, int32 InUp, int32 InUpLeft )
+    {
+        const auto p  = InLeft + InUp - InUpLeft;
+        const auto pa = FMath::Abs( p - InLeft );
+        const auto pb = FMath::Abs( p - InUp );
+        const auto pc = FMath::Abs( p - InUpLeft );
+        if ( (pa <= pb) && (pa <= pc) )
+            return (uint8)InLeft;
+        return (pb <= pc) ? (uint8)InUp : (uint8)InUpLeft;
+    }
+
+    void LoadRow( const FSCIPngEncoder::FSource& InSource, int32 InRow, uint8* OutRow )
+    {
+        const auto rowSize = (int64)InSource.Resolution.X * GetBytesPerPixel( InSource );
+        const auto source  = InSource.Data + InRow * rowSize;
+        if ( !InSource.IsBGRA || (InSource.BitDepth != 8) ) {
+            FMemory::Memcpy( OutRow, source, rowSize );
+            return;
+        }
+
+        FSCIPixelKernels::BgraToRgba( reinterpret_cast<const FColor*>( source ), InSource.Resolution.X, OutRow );
+    }
+
+    // Picks the filter with the minimum sum of absolute differences, like libpng's heuristic.
+    void FilterRow( const uint8* InRow, const uint8* InPrevRow, int64 InRowSize, int32 InBytesPerPixel, bool InIsStored, uint8* OutFiltered )
+    {
+        if ( InIsStored ) {
+            OutFiltered[ 0 ] = 0;
+            FMemory::Memcpy( OutFiltered + 1, InRow, InRowSize );
+            return;
+        }
+
+        uint64 costs[ 5 ] = { 0, 0, 0, 0, 0 };
+        for ( int64 i = 0; i < InRowSize; i++ ) {
+            const int32 raw    = InRow[ i ];
+            const int32 left   = (i >= InBytesPerPixel) ? InRow[ i - InBytesPerPixel ] : 0;
+            const int32 up     = InPrevRow[ i ];
+            const int32 upLeft = (i >= InBytesPerPixel) ? InPrevRow[ i - InBytesPerPixel ] : 0;
+
+            // Widened before Abs, an int8 -128 stays negative and wraps the cost.
+            costs[ 0 ] += FMath::Abs( (int32)(int8)raw );
+            costs[ 1 ] += FMath::Abs( (int32)(int8)(uint8)(raw - left) );
+            costs[ 2 ] += FMath::Abs( (int32)(int8)(uint8)(raw - up) );
+            costs[ 3 ] += FMath::Abs( (int32)(int8)(uint8)(raw - ((left + up) >> 1)) );
+            costs[ 4 ] += FMath::Abs( (int32)(int8)(uint8)(raw - PaethPredictor( left, up, upLeft )) );
+        }
+
+        uint8 filter = 0;
+        for ( uint8 f = 1; f < 5; f++ ) {
+            if ( costs[ f ] < costs[ filter ] )
+                filter = f;
+        }
+
+        OutFiltered[ 0 ] = filter;
+        auto out = OutFiltered + 1;
+        for ( int64 i = 0; i < InRowSize; i++ ) {
+            const int32 raw    = InRow[ i ];
+            const int32 left   = (i >= InBytesPerPixel) ? InRow[ i - InBytesPerPixel ] : 0;
+            const int32 up     = InPrevRow[ i ];
+            const int32 upLeft = (i >= InBytesPerPixel) ? InPrevRow[ i - InBytesPerPixel ] : 0;
+
+            switch ( filter ) {
+                case 0: out[ i ] = (uint8)raw;                                      break;
+                case 1: out[ i ] = (uint8)(raw - left);                             break;
+                case 2: out[ i ] = (uint8)(raw - up);                               break;
+                case 3: out[ i ] = (uint8)(raw - ((left + up) >> 1));               break;
+                case 4: out[ i ] = (uint8)(raw - PaethPredictor( left, up, upLeft )); break;
+            }
+        }
+    }
+
+    void FilterBand( const FSCIPngEncoder::FSource& InSource, bool InIsStored, FPngBand& InOutBand )
+    {
+        const auto bytesPerPixel = GetBytesPerPixel( InSource );
+        const auto rowSize       = (int64)InSource.Resolution.X * bytesPerPixel;
+        InOutBand.Filtered.SetNumUninitialized( (rowSize + 1) * InOutBand.RowCount );
+
+        TArray64<uint8> rows;
+        rows.SetNumZeroed( rowSize * 2 );
+        auto prevRow = rows.GetData();
+        auto row     = rows.GetData() + rowSize;
+
+        // The first row of a band still filters against the last row of the previous band.
+        if ( InOutBand.FirstRow > 0 )
+            LoadRow( InSource, InOutBand.FirstRow - 1, prevRow );
+
+        for ( int32 y = 0; y < InOutBand.RowCount; y++ ) {
+            LoadRow( InSource, InOutBand.FirstRow + y, row );
+            FilterRow( row, prevRow, rowSize, bytesPerPixel, InIsStored, InOutBand.Filtered.GetData() + y * (rowSize + 1) );
+            Swap( row, prevRow );
+        }
+
+        InOutBand.Adler = adler32( 1L, InOutBand.Filtered.GetData(), (uInt)InOutBand.Filtered.Num() );
+    }
+
+    void DeflateBand( int32 InCompressionLevel, const FPngBand* InPrevBand, bool InIsLast, FPngBand& InOutBand )
+    {
+        z_stream stream;
+        FMemory::Memzero( stream );
+        if ( deflateInit2( &stream, InCompressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+            return;
+
+        if ( (InPrevBand != nullptr) && (InCompressionLevel > 0) ) {
+            const auto dictionarySize = FMath::Min<int64>( InPrevBand->Filtered.Num(), DEFLATE_WINDOW_SIZE );
+            deflateSetDictionary( &stream, InPrevBand->Filtered.GetData() + InPrevBand->Filtered.Num() - dictionarySize, (uInt)dictionarySize );
+        }
+
+        // Room for the worst case plus the empty stored block of the sync flush.
+        InOutBand.Compressed.SetNumUninitialized( deflateBound( &stream, (uLong)InOutBand.Filtered.Num() ) + 16 );
+
+        stream.next_in   = InOutBand.Filtered.GetData();
+        stream.avail_in  = (uInt)InOutBand.Filtered.Num();
+        stream.next_out  = InOutBand.Compressed.GetData();
+        stream.avail_out = (uInt)InOutBand.Compressed.Num();
+
+        const auto result = deflate( &stream, InIsLast ? Z_FINISH : Z_SYNC_FLUSH );
+        InOutBand.IsSucceeded = InIsLast ? (result == Z_STREAM_END) : ((result == Z_OK) && (stream.avail_in == 0));
+        InOutBand.Compressed.SetNum( stream.total_out, false );
+
+        deflateEnd( &stream );
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+int32 FSCIPngEncoder::GetDefaultBandCount( int32 InHeight )
+{
+    const auto maxBands = FMath::Max( InHeight / SCI::PNG_MIN_BAND_ROWS, 1 );
+    return FMath::Clamp( FPlatformMisc::NumberOfCoresIncludingHyperthreads(), 1, maxBands );
+}
+
+bool FSCIPngEncoder::Encode( const FSource& InSource, int32 InCompressionLevel, int32 InBandCount, TArray64<uint8>& OutPng )
+{
+    const auto width  = InSource.Resolution.X;
+    const auto height = InSource.Resolution.Y;
+    if ( (InSource.Data == nullptr) || (width <= 0) || (height <= 0) || ((InSource.BitDepth != 8) && (InSource.BitDepth != 16)) )
+        return false;
+
+    const auto level     = FMath::Clamp( InCompressionLevel, 0, 9 );
+    const auto bandCount = FMath::Clamp( InBandCount > 0 ? InBandCount : GetDefaultBandCount( height ), 1, height );
+
+    TArray<SCI::FPngBand> bands;
+    bands.SetNum( bandCount );
+    const auto rowsPerBand = height / bandCount;
+    for ( int32 i = 0; i < bandCount; i++ ) {
+        bands[ i ].FirstRow = i * rowsPerBand;
+        bands[ i ].RowCount = (i == bandCount - 1) ? (height - bands[ i ].FirstRow) : rowsPerBand;
+    }
+
+    // Filtering first, so every band can use the previous band's tail as its dictionary.
+    ParallelFor( bandCount, [&]( int32 InIndex ){
+        SCI::FilterBand( InSource, level == 0, bands[ InIndex ] );
+    });
+    ParallelFor( bandCount, [&]( int32 InIndex ){
+        SCI::DeflateBand( level, InIndex > 0 ? &bands[ InIndex - 1 ] : nullptr, InIndex == bandCount - 1, bands[ InIndex ] );
+    });
+
+    uLong adler = 1;
+    int64 compressedSize = 0;
+    for ( const auto& band : bands ) {
+        if ( !band.IsSucceeded ) {
+            VLOG( Error, TEXT( "Failed to deflate png band at row %d." ), band.FirstRow );
+            return false;
+        }
+        adler = adler32_combine( adler, band.Adler, (z_off_t)band.Filtered.Num() );
+        compressedSize += band.Compressed.Num();
+    }
+
+    OutPng.Reset( compressedSize + 128 + bandCount * 12 );
+
+    static const uint8 PNG_SIGNATURE[ 8 ] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    OutPng.Append( PNG_SIGNATURE, 8 );
+
+    uint8 header[ 13 ];
+    header[ 0 ] = (uint8)(width >> 24);  header[ 1 ] = (uint8)(width >> 16);  header[ 2 ] = (uint8)(width >> 8);  header[ 3 ] = (uint8)width;
+    header[ 4 ] = (uint8)(height >> 24); header[ 5 ] = (uint8)(height >> 16); header[ 6 ] = (uint8)(height >> 8); header[ 7 ] = (uint8)height;
+    header[ 8 ]  = (uint8)InSource.BitDepth;
+    header[ 9 ]  = 6;   // Color type: RGBA
+    header[ 10 ] = 0;   // Deflate
+    header[ 11 ] = 0;   // Adaptive filtering
+    header[ 12 ] = 0;   // No interlace
+    SCI::WriteChunk( OutPng, "IHDR", header, sizeof( header ) );
+
+    // One IDAT per band; the zlib header leads the first and the adler32 trails the last.
+    for ( int32 i = 0; i < bandCount; i++ ) {
+        TArray64<uint8> payload;
+        payload.Reserve( bands[ i ].Compressed.Num() + 6 );
+        if ( i == 0 ) {
+            const uint8 levelFlag = (level <= 1) ? 0 : ((level <= 5) ? 1 : ((level == 6) ? 2 : 3));
+            const uint16 zlibHeader = (0x78 << 8) | (levelFlag << 6);
+            payload.Add( 0x78 );
+            payload.Add( (uint8)((levelFlag << 6) + ((31 - (zlibHeader % 31)) % 31)) );
+        }
+        payload.Append( bands[ i ].Compressed );
+        if ( i == bandCount - 1 )
+            SCI::WriteBigEndian32( payload, (uint32)adler );
+
+        SCI::WriteChunk( OutPng, "IDAT", payload.GetData(), payload.Num() );
+    }
+
+    SCI::WriteChunk( OutPng, "IEND", nullptr, 0 );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+static FAutoConsoleCommand GSCIBenchmarkPngCommand(
+    TEXT( "SCI.BenchmarkPng" ),
+    TEXT( "Compares the banded png encoder with the ImageWrapper path. Usage: SCI.BenchmarkPng [Width] [Height] [Iterations] [Level]" ),
+    FConsoleCommandWithArgsDelegate::CreateLambda( []( const TArray<FString>& InArgs ){
+        const auto width      = InArgs.IsValidIndex( 0 ) ? FCString::Atoi( *InArgs[ 0 ] ) : 1920;
+        const auto height     = InArgs.IsValidIndex( 1 ) ? FCString::Atoi( *InArgs[ 1 ] ) : 1080;
+        const auto iterations = InArgs.IsValidIndex( 2 ) ? FMath::Max( FCString::Atoi( *InArgs[ 2 ] ), 1 ) : 5;
+        const auto level      = InArgs.IsValidIndex( 3 ) ? FCString::Atoi( *InArgs[ 3 ] ) : 6;
+
+        // Smooth gradients with a little noise, roughly like rendered frames.
+        FRandomStream random( 1234 );
+        TArray<FColor> pixels;
+        pixels.SetNumUninitialized( width * height );
+        for ( int32 y = 0; y < height; y++ ) {
+            for ( int32 x = 0; x < width; x++ ) {
+                const auto noise = random.RandRange( 0, 7 );
+                pixels[ y * width + x ] = FColor( (uint8)((x * 255 / width) + noise), (uint8)((y * 255 / height) + noise), (uint8)(((x + y) & 0xFF) ^ noise), 255 );
+            }
+        }
+        const auto rawSize = (int64)pixels.Num() * sizeof( FColor );
+
+        auto& imageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>( FName( TEXT( "ImageWrapper" ) ) );
+        auto imageWrapper        = imageWrapperModule.CreateImageWrapper( EImageFormat::PNG );
+
+        int64 wrapperSize = 0;
+        auto startTime    = FPlatformTime::Seconds();
+        for ( int32 i = 0; i < iterations; i++ ) {
+            imageWrapper->SetRaw( pixels.GetData(), rawSize, width, height, ERGBFormat::BGRA, 8 );
+            wrapperSize = imageWrapper->GetCompressed( (int32)EImageCompressionQuality::Default ).Num();
+        }
+        const auto wrapperMs = (FPlatformTime::Seconds() - startTime) * 1000.0 / iterations;
+
+        FSCIPngEncoder::FSource source;
+        source.Data       = reinterpret_cast<const uint8*>( pixels.GetData() );
+        source.Resolution = FIntPoint( width, height );
+
+        TArray64<uint8> png;
+        startTime = FPlatformTime::Seconds();
+        for ( int32 i = 0; i < iterations; i++ )
+            FSCIPngEncoder::Encode( source, level, 0, png );
+        const auto bandedMs = (FPlatformTime::Seconds() - startTime) * 1000.0 / iterations;
+
+        VLOG( Display, TEXT( "PNG %dx%d, %d iterations. ImageWrapper: %.2f ms (%lld bytes), Banded level %d x %d bands: %.2f ms (%lld bytes), Speedup: %.2fx" )
+        , width, height, iterations, wrapperMs, wrapperSize, level, FSCIPngEncoder::GetDefaultBandCount( height ), bandedMs, png.Num()
+        , bandedMs > 0.0 ? wrapperMs / bandedMs : 0.0 );
+    })
+);
@@ -0,0 +1,24 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+
+// PNG encoder that splits the image into row bands and deflates every band on its own core.
+// Bands end on a sync flush and are primed with the previous band's tail as dictionary
+// (pigz style), so the joined pieces form one valid zlib stream inside the IDAT chunks.
+class FSCIPngEncoder
+{
+public:
+    struct FSource
+    {
+        const uint8* Data = nullptr;
+        FIntPoint Resolution = FIntPoint::ZeroValue;
+        // 8-bit BGRA pixels are swizzled to RGBA while filtering.
+        bool IsBGRA = true;
+        // 16 expects big-endian RGBA16 samples.
+        int32 BitDepth = 8;
+    };
+
+    static bool Encode( const FSource& InSource, int32 InCompressionLevel, int32 InBandCount, TArray64<uint8>& OutPng );
+
+    static int32 GetDefaultBandCount( int32 InHeight );
+};
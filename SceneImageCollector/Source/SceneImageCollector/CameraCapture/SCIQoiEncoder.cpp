@@ -0,0 +1,115 @@
+#include "SCIQoiEncoder.h"
+
+namespace SCI
+{
+    constexpr uint8 QOI_OP_INDEX = 0x00;
+    constexpr uint8 QOI_OP_DIFF  = 0x40;
+    constexpr uint8 QOI_OP_LUMA  = 0x80;
+    constexpr uint8 QOI_OP_RUN   = 0xC0;
+    constexpr uint8 QOI_OP_RGB   = 0xFE;
+    constexpr uint8 QOI_OP_RGBA  = 0xFF;
+
+    constexpr int32 QOI_HEADER_SIZE  = 14;
+    constexpr int32 QOI_PADDING_SIZE = 8;
+    constexpr int32 QOI_MAX_RUN      = 62;
+
+    FORCEINLINE uint32 QoiHash( const FColor& InColor )
+    {
+        return (InColor.R * 3 + InColor.G * 5 + InColor.B * 7 + InColor.A * 11) % 64;
+    }
+
+    FORCEINLINE void QoiWrite32( uint8*& InOutCursor, uint32 InValue )
+    {
+        *InOutCursor++ = (uint8)(InValue >> 24);
+        *InOutCursor++ = (uint8)(InValue >> 16);
+        *InOutCursor++ = (uint8)(InValue >> 8);
+        *InOutCursor++ = (uint8)InValue;
+    }
+}
+
+bool FSCIQoiEncoder::Encode( const FColor* InPixels, const FIntPoint& InResolution, TArray64<uint8>& OutQoi )
+{
+    const auto pixelCount = (int64)InResolution.X * InResolution.Y;
+    if ( (InPixels == nullptr) || (pixelCount <= 0) )
+        return false;
+
+    // Worst case is one QOI_OP_RGBA per pixel.
+    OutQoi.SetNumUninitialized( SCI::QOI_HEADER_SIZE + pixelCount * 5 + SCI::QOI_PADDING_SIZE );
+    auto cursor = OutQoi.GetData();
+
+    *cursor++ = 'q'; *cursor++ = 'o'; *cursor++ = 'i'; *cursor++ = 'f';
+    SCI::QoiWrite32( cursor, (uint32)InResolution.X );
+    SCI::QoiWrite32( cursor, (uint32)InResolution.Y );
+    *cursor++ = 4;  // RGBA
+    *cursor++ = 0;  // sRGB with linear alpha
+
+    FColor index[ 64 ];
+    FMemory::Memzero( index );
+
+    auto previous = FColor( 0, 0, 0, 255 );
+    int32 run = 0;
+    for ( int64 i = 0; i < pixelCount; i++ ) {
+        // FColor is stored as BGRA, QOI hashes and diffs by channel so the layout does not matter.
+        const auto& pixel = InPixels[ i ];
+        if ( pixel == previous ) {
+            run++;
+            if ( (run == SCI::QOI_MAX_RUN) || (i == pixelCount - 1) ) {
+                *cursor++ = SCI::QOI_OP_RUN | (uint8)(run - 1);
+                run = 0;
+            }
+            continue;
+        }
+
+        if ( run > 0 ) {
+            *cursor++ = SCI::QOI_OP_RUN | (uint8)(run - 1);
+            run = 0;
+        }
+
+        const auto hash = SCI::QoiHash( pixel );
+        if ( index[ hash ] == pixel ) {
+            *cursor++ = SCI::QOI_OP_INDEX | (uint8)hash;
+        }
+        else {
+            index[ hash ] = pixel;
+
+            if ( pixel.A == previous.A ) {
+                const int8 vr  = (int8)(pixel.R - previous.R);
+                const int8 vg  = (int8)(pixel.G - previous.G);
+                const int8 vb  = (int8)(pixel.B - previous.B);
+                const int8 vgr = (int8)(vr - vg);
+                const int8 vgb = (int8)(vb - vg);
+
+                if ( (vr > -3) && (vr < 2) && (vg > -3) && (vg < 2) && (vb > -3) && (vb < 2) ) {
+                    *cursor++ = SCI::QOI_OP_DIFF | (uint8)((vr + 2) << 4) | (uint8)((vg + 2) << 2) | (uint8)(vb + 2);
+                }
+                else if ( (vgr > -9) && (vgr < 8) && (vg > -33) && (vg < 32) && (vgb > -9) && (vgb < 8) ) {
+                    *cursor++ = SCI::QOI_OP_LUMA | (uint8)(vg + 32);
+                    *cursor++ = (uint8)((vgr + 8) << 4) | (uint8)(vgb + 8);
+                }
+                else {
+                    *cursor++ = SCI::QOI_OP_RGB;
+                    *cursor++ = pixel.R;
+                    *cursor++ = pixel.G;
+                    *cursor++ = pixel.B;
+                }
+            }
+            else {
+                *cursor++ = SCI::QOI_OP_RGBA;
+                *cursor++ = pixel.R;
+                *cursor++ = pixel.G;
+                *cursor++ = pixel.B;
+                *cursor++ = pixel.A;
+            }
+        }
+
+        previous = pixel;
+    }
+
+    // End marker: seven 0x00 followed by 0x01.
+    for ( int32 i = 0; i < SCI::QOI_PADDING_SIZE - 1; i++ )
+        *cursor++ = 0;
+    *cursor++ = 1;
+
+    OutQoi.SetNum( cursor - OutQoi.GetData(), false );
+    return true;
+}
@@ -0,0 +1,11 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+
+// "Quite OK Image" encoder: lossless run/index/delta codec that is several times
+// faster than deflate based png. See https://qoiformat.org/qoi-specification.pdf
+class FSCIQoiEncoder
+{
+public:
+    static bool Encode( const FColor* InPixels, const FIntPoint& InResolution, TArray64<uint8>& OutQoi );
+};
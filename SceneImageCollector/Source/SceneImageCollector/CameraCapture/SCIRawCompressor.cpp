@@ -0,0 +1,393 @@
+#include "SCIRawCompressor.h"
+#include "SCIPngEncoder.h"
+#include "../VLog.h"
+#include <HAL/IConsoleManager.h>
+#include <Math/RandomStream.h>
+#include <Misc/ScopeLock.h>
+
+#if WITH_SCI_ZSTD
+THIRD_PARTY_INCLUDES_START
+#include <zstd.h>
+#include <zdict.h>
+THIRD_PARTY_INCLUDES_END
+#endif
+
+namespace SCI
+{
+    constexpr int32 RAW_MIN_LEVEL = -7;
+    constexpr int32 RAW_MAX_LEVEL = 19;
+    // zstd trains best on many small samples, about a hundred times the dictionary size in total.
+    constexpr int64 RAW_DICTIONARY_SAMPLE_SIZE   = 16 * 1024;
+    constexpr int64 RAW_DICTIONARY_SAMPLE_FACTOR = 100;
+
+    // Byte n of every value goes to plane n.
+    void ShuffleRawBytes( const uint8* InData, int64 InSize, int32 InShuffleSize, uint8* OutData )
+    {
+        const auto valueCount = InSize / InShuffleSize;
+        for ( int32 plane = 0; plane < InShuffleSize; plane++ ) {
+            auto out = OutData + plane * valueCount;
+            for ( int64 i = 0; i < valueCount; i++ )
+                out[ i ] = InData[ i * InShuffleSize + plane ];
+        }
+
+        const auto tail = valueCount * InShuffleSize;
+        FMemory::Memcpy( OutData + tail, InData + tail, InSize - tail );
+    }
+
+    void UnshuffleRawBytes( const uint8* InData, int64 InSize, int32 InShuffleSize, uint8* OutData )
+    {
+        const auto valueCount = InSize / InShuffleSize;
+        for ( int32 plane = 0; plane < InShuffleSize; plane++ ) {
+            auto in = InData + plane * valueCount;
+            for ( int64 i = 0; i < valueCount; i++ )
+                OutData[ i * InShuffleSize + plane ] = in[ i ];
+        }
+
+        const auto tail = valueCount * InShuffleSize;
+        FMemory::Memcpy( OutData + tail, InData + tail, InSize - tail );
+    }
+
+#if WITH_SCI_ZSTD
+    // Compression contexts keep their zstd workers and match tables from one frame to the next.
+    class FZstdContextPool
+    {
+    public:
+        ~FZstdContextPool()
+        {
+            for ( auto context : FreeContexts )
+                ZSTD_freeCCtx( context );
+        }
+
+        ZSTD_CCtx* Acquire()
+        {
+            FScopeLock lock( &Mutex );
+            return FreeContexts.IsEmpty() ? ZSTD_createCCtx() : FreeContexts.Pop( false );
+        }
+
+        void Release( ZSTD_CCtx* InContext )
+        {
+            FScopeLock lock( &Mutex );
+            FreeContexts.Add( InContext );
+        }
+
+        static FZstdContextPool& Get()
+        {
+            static FZstdContextPool POOL;
+            return POOL;
+        }
+
+    private:
+        FCriticalSection Mutex;
+        TArray<ZSTD_CCtx*> FreeContexts;
+    };
+#endif
+}
+
+//-----------------------------------------------------------------------------
+
+FSCIRawDictionary::FSCIRawDictionary()
+: FrameCount( 0 ), MaxSize( 0 ), Level( 0 ), AddedFrameCount( 0 ), CompressionDictionary( nullptr ), Id( 0 ), IsDataTaken( false )
+{
+}
+
+FSCIRawDictionary::~FSCIRawDictionary()
+{
+    Release();
+}
+
+void FSCIRawDictionary::Initialize( const FString& InFilename, int32 InFrameCount, int32 InMaxSize, int32 InLevel )
+{
+    Release();
+    if ( !FSCIRawCompressor::IsAvailable() || (InFrameCount <= 0) || (InMaxSize <= 0) )
+        return;
+
+    FScopeLock lock( &Mutex );
+    Filename   = InFilename;
+    FrameCount = InFrameCount;
+    MaxSize    = InMaxSize;
+    Level      = FMath::Clamp( InLevel, SCI::RAW_MIN_LEVEL, SCI::RAW_MAX_LEVEL );
+}
+
+void FSCIRawDictionary::Release()
+{
+    FScopeLock lock( &Mutex );
+#if WITH_SCI_ZSTD
+    ZSTD_freeCDict( CompressionDictionary );
+#endif
+    CompressionDictionary = nullptr;
+    Filename.Empty();
+    FrameCount      = 0;
+    AddedFrameCount = 0;
+    Id              = 0;
+    IsDataTaken     = false;
+    Samples.Empty();
+    SampleSizes.Empty();
+    Data.Empty();
+}
+
+bool FSCIRawDictionary::IsInitialized() const
+{
+    FScopeLock lock( &Mutex );
+    return FrameCount > 0;
+}
+
+const FString& FSCIRawDictionary::GetFilename() const
+{
+    return Filename;
+}
+
+void FSCIRawDictionary::AddFrame( const uint8* InData, int64 InSize )
+{
+    TArray<uint8> samples;
+    TArray<size_t> sampleSizes;
+    {
+        FScopeLock lock( &Mutex );
+        if ( AddedFrameCount >= FrameCount )
+            return;
+
+        // Evenly spread over the frame, so the samples cover the whole image.
+        const auto frameBudget = (int64)MaxSize * SCI::RAW_DICTIONARY_SAMPLE_FACTOR / FrameCount;
+        const auto sampleSize  = FMath::Min( SCI::RAW_DICTIONARY_SAMPLE_SIZE, InSize );
+        const auto sampleCount = FMath::Clamp( frameBudget / SCI::RAW_DICTIONARY_SAMPLE_SIZE, (int64)1, InSize / FMath::Max( sampleSize, (int64)1 ) );
+        for ( int64 i = 0; i < sampleCount; i++ ) {
+            Samples.Append( InData + i * (InSize / sampleCount), (int32)sampleSize );
+            SampleSizes.Add( (size_t)sampleSize );
+        }
+
+        if ( ++AddedFrameCount < FrameCount )
+            return;
+
+        samples     = MoveTemp( Samples );
+        sampleSizes = MoveTemp( SampleSizes );
+    }
+
+    // Outside the lock, the other workers keep compressing without a dictionary meanwhile.
+    Train( MoveTemp( samples ), MoveTemp( sampleSizes ) );
+}
+
+void FSCIRawDictionary::Train( TArray<uint8>&& InSamples, TArray<size_t>&& InSampleSizes )
+{
+#if WITH_SCI_ZSTD
+    TArray<uint8> data;
+    data.SetNumUninitialized( MaxSize );
+    const auto size = ZDICT_trainFromBuffer( data.GetData(), data.Num(), InSamples.GetData(), InSampleSizes.GetData(), (unsigned)InSampleSizes.Num() );
+    if ( ZDICT_isError( size ) ) {
+        VLOG( Warning, TEXT( "Failed to train the raw frame dictionary, frames stay compressed without one: %s" ), ANSI_TO_TCHAR( ZDICT_getErrorName( size ) ) );
+        return;
+    }
+    data.SetNum( (int32)size );
+
+    auto compressionDictionary = ZSTD_createCDict( data.GetData(), data.Num(), Level );
+    if ( compressionDictionary == nullptr )
+        return;
+
+    FScopeLock lock( &Mutex );
+    Id                    = ZDICT_getDictID( data.GetData(), data.Num() );
+    Data                  = MoveTemp( data );
+    CompressionDictionary = compressionDictionary;
+    VLOG( Log, TEXT( "Trained a %d byte raw frame dictionary %u on %d frames: %s" ), Data.Num(), Id, FrameCount, *Filename );
+#endif
+}
+
+bool FSCIRawDictionary::TakeTrainedData( TArray64<uint8>& OutData )
+{
+    FScopeLock lock( &Mutex );
+    if ( (CompressionDictionary == nullptr) || IsDataTaken )
+        return false;
+
+    IsDataTaken = true;
+    OutData.Reset( Data.Num() );
+    OutData.Append( Data.GetData(), Data.Num() );
+    return true;
+}
+
+const ZSTD_CDict_s* FSCIRawDictionary::GetCompressionDictionary() const
+{
+    FScopeLock lock( &Mutex );
+    return CompressionDictionary;
+}
+
+uint32 FSCIRawDictionary::GetId() const
+{
+    FScopeLock lock( &Mutex );
+    return Id;
+}
+
+//-----------------------------------------------------------------------------
+
+bool FSCIRawCompressor::IsAvailable()
+{
+    return WITH_SCI_ZSTD != 0;
+}
+
+bool FSCIRawCompressor::Compress( const uint8* InPixels, const FIntPoint& InResolution, int32 InBytesPerPixel, const FOptions& InOptions, TArray64<uint8>& OutData )
+{
+#if WITH_SCI_ZSTD
+    FHeader header;
+    header.Width         = InResolution.X;
+    header.Height        = InResolution.Y;
+    header.BytesPerPixel = InBytesPerPixel;
+    header.RawSize       = (int64)InResolution.X * InResolution.Y * InBytesPerPixel;
+    if ( (InPixels == nullptr) || (header.RawSize <= 0) )
+        return false;
+
+    // Half floats are shuffled by their two bytes, 8-bit channels compress well as they are.
+    header.ShuffleSize = InBytesPerPixel == sizeof( FFloat16Color ) ? sizeof( FFloat16 ) : 1;
+    header.Level       = (int8)FMath::Clamp( InOptions.Level, SCI::RAW_MIN_LEVEL, SCI::RAW_MAX_LEVEL );
+
+    TArray64<uint8> shuffled;
+    auto input = InPixels;
+    if ( header.ShuffleSize > 1 ) {
+        shuffled.SetNumUninitialized( header.RawSize );
+        SCI::ShuffleRawBytes( InPixels, header.RawSize, header.ShuffleSize, shuffled.GetData() );
+        input = shuffled.GetData();
+    }
+
+    // The dictionary learns from exactly the bytes it later compresses.
+    const ZSTD_CDict* compressionDictionary = nullptr;
+    if ( InOptions.Dictionary != nullptr ) {
+        InOptions.Dictionary->AddFrame( input, header.RawSize );
+        compressionDictionary = InOptions.Dictionary->GetCompressionDictionary();
+        header.DictionaryId   = compressionDictionary != nullptr ? InOptions.Dictionary->GetId() : 0;
+    }
+
+    // ZSTD_compressCCtx ignores the advanced parameters, so the frame goes through ZSTD_compress2.
+    // A zstd built without ZSTD_MULTITHREAD rejects the workers and compresses on this thread.
+    auto context = SCI::FZstdContextPool::Get().Acquire();
+    ZSTD_CCtx_setParameter( context, ZSTD_c_compressionLevel, header.Level );
+    ZSTD_CCtx_setParameter( context, ZSTD_c_checksumFlag, 1 );
+    ZSTD_CCtx_setParameter( context, ZSTD_c_nbWorkers, FMath::Max( InOptions.WorkerCount, 0 ) );
+    ZSTD_CCtx_refCDict( context, compressionDictionary );
+
+    const auto frameCapacity = ZSTD_compressBound( header.RawSize );
+    OutData.SetNumUninitialized( sizeof( header ) + frameCapacity );
+    const auto frameSize = ZSTD_compress2( context, OutData.GetData() + sizeof( header ), frameCapacity, input, header.RawSize );
+
+    // Pooled contexts never hold on to a dictionary.
+    ZSTD_CCtx_refCDict( context, nullptr );
+    SCI::FZstdContextPool::Get().Release( context );
+
+    if ( ZSTD_isError( frameSize ) ) {
+        VLOG( Error, TEXT( "Failed to compress a raw frame: %s" ), ANSI_TO_TCHAR( ZSTD_getErrorName( frameSize ) ) );
+        OutData.Reset();
+        return false;
+    }
+
+    FMemory::Memcpy( OutData.GetData(), &header, sizeof( header ) );
+    OutData.SetNum( sizeof( header ) + frameSize, false );
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool FSCIRawCompressor::Decompress( const uint8* InData, int64 InSize, TArray64<uint8>& OutPixels, FHeader* OutHeader, TArrayView<const uint8> InDictionary )
+{
+#if WITH_SCI_ZSTD
+    FHeader header;
+    if ( (InData == nullptr) || (InSize < (int64)sizeof( header )) )
+        return false;
+
+    FMemory::Memcpy( &header, InData, sizeof( header ) );
+    if ( (FMemory::Memcmp( header.Magic, FHeader().Magic, 4 ) != 0) || (header.Version != FHeader().Version) || (header.ShuffleSize == 0)
+    || (header.RawSize <= 0) || (header.RawSize != (int64)header.Width * header.Height * header.BytesPerPixel) ) {
+        return false;
+    }
+
+    // The frame states its size, which also rejects truncated or foreign data.
+    const auto frame     = InData + sizeof( header );
+    const auto frameSize = InSize - (int64)sizeof( header );
+    if ( ZSTD_getFrameContentSize( frame, frameSize ) != (unsigned long long)header.RawSize )
+        return false;
+
+    TArray64<uint8> shuffled;
+    OutPixels.SetNumUninitialized( header.RawSize );
+    auto destination = OutPixels.GetData();
+    if ( header.ShuffleSize > 1 ) {
+        shuffled.SetNumUninitialized( header.RawSize );
+        destination = shuffled.GetData();
+    }
+
+    auto context = ZSTD_createDCtx();
+    const auto size = ZSTD_decompress_usingDict( context, destination, header.RawSize, frame, frameSize, InDictionary.GetData(), InDictionary.Num() );
+    ZSTD_freeDCtx( context );
+    if ( ZSTD_isError( size ) || (size != (size_t)header.RawSize) )
+        return false;
+
+    if ( header.ShuffleSize > 1 )
+        SCI::UnshuffleRawBytes( shuffled.GetData(), header.RawSize, header.ShuffleSize, OutPixels.GetData() );
+
+    if ( OutHeader != nullptr )
+        *OutHeader = header;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+
+static FAutoConsoleCommand GSCIBenchmarkRawCompressionCommand(
+    TEXT( "SCI.BenchmarkRawCompression" ),
+    TEXT( "Compares compressed raw frames with the banded png encoder. Usage: SCI.BenchmarkRawCompression [Width] [Height] [Iterations] [Level] [PngLevel] [Workers]" ),
+    FConsoleCommandWithArgsDelegate::CreateLambda( []( const TArray<FString>& InArgs ){
+        const auto width      = InArgs.IsValidIndex( 0 ) ? FCString::Atoi( *InArgs[ 0 ] ) : 1920;
+        const auto height     = InArgs.IsValidIndex( 1 ) ? FCString::Atoi( *InArgs[ 1 ] ) : 1080;
+        const auto iterations = InArgs.IsValidIndex( 2 ) ? FMath::Max( FCString::Atoi( *InArgs[ 2 ] ), 1 ) : 5;
+        const auto level      = InArgs.IsValidIndex( 3 ) ? FCString::Atoi( *InArgs[ 3 ] ) : 1;
+        const auto pngLevel   = InArgs.IsValidIndex( 4 ) ? FCString::Atoi( *InArgs[ 4 ] ) : 1;
+        const auto workers    = InArgs.IsValidIndex( 5 ) ? FCString::Atoi( *InArgs[ 5 ] ) : 0;
+
+        // Smooth gradients with a little noise, roughly like rendered frames.
+        FRandomStream random( 1234 );
+        TArray<FColor> pixels;
+        TArray<FFloat16Color> halfPixels;
+        pixels.SetNumUninitialized( width * height );
+        halfPixels.SetNumUninitialized( width * height );
+        for ( int32 y = 0; y < height; y++ ) {
+            for ( int32 x = 0; x < width; x++ ) {
+                const auto noise = random.RandRange( 0, 7 );
+                pixels[ y * width + x ] = FColor( (uint8)((x * 255 / width) + noise), (uint8)((y * 255 / height) + noise), (uint8)(((x + y) & 0xFF) ^ noise), 255 );
+                halfPixels[ y * width + x ] = FFloat16Color( FLinearColor( (float)x / width, (float)y / height, noise / 64.0f, 1.0f ) );
+            }
+        }
+
+        auto report = [&]( const TCHAR* InName, const uint8* InPixels, int32 InBytesPerPixel ){
+            FSCIRawCompressor::FOptions options;
+            options.Level       = level;
+            options.WorkerCount = workers;
+
+            TArray64<uint8> compressed;
+            const auto startTime = FPlatformTime::Seconds();
+            for ( int32 i = 0; i < iterations; i++ )
+                FSCIRawCompressor::Compress( InPixels, FIntPoint( width, height ), InBytesPerPixel, options, compressed );
+            const auto seconds = (FPlatformTime::Seconds() - startTime) / iterations;
+
+            TArray64<uint8> decompressed;
+            const auto rawSize     = (int64)width * height * InBytesPerPixel;
+            const auto isRoundTrip = FSCIRawCompressor::Decompress( compressed.GetData(), compressed.Num(), decompressed )
+            && (decompressed.Num() == rawSize) && (FMemory::Memcmp( decompressed.GetData(), InPixels, rawSize ) == 0);
+
+            VLOG( Display, TEXT( "%s level %d, %d workers: %.2f ms, ratio %.2f, %.0f MB/s, round trip %s" ), InName, level, workers, seconds * 1000.0
+            , compressed.Num() > 0 ? (double)rawSize / compressed.Num() : 0.0, seconds > 0.0 ? rawSize / (seconds * 1024.0 * 1024.0) : 0.0
+            , isRoundTrip ? TEXT( "OK" ) : TEXT( "FAILED" ) );
+        };
+        report( TEXT( "Raw BGRA8" ), reinterpret_cast<const uint8*>( pixels.GetData() ), sizeof( FColor ) );
+        report( TEXT( "Raw RGBA16F" ), reinterpret_cast<const uint8*>( halfPixels.GetData() ), sizeof( FFloat16Color ) );
+
+        FSCIPngEncoder::FSource source;
+        source.Data       = reinterpret_cast<const uint8*>( pixels.GetData() );
+        source.Resolution = FIntPoint( width, height );
+
+        TArray64<uint8> png;
+        const auto startTime = FPlatformTime::Seconds();
+        for ( int32 i = 0; i < iterations; i++ )
+            FSCIPngEncoder::Encode( source, pngLevel, 0, png );
+        const auto seconds = (FPlatformTime::Seconds() - startTime) / iterations;
+        const auto rawSize = (int64)pixels.Num() * sizeof( FColor );
+
+        VLOG( Display, TEXT( "Banded png level %d: %.2f ms, ratio %.2f, %.0f MB/s" ), pngLevel, seconds * 1000.0
+        , png.Num() > 0 ? (double)rawSize / png.Num() : 0.0, seconds > 0.0 ? rawSize / (seconds * 1024.0 * 1024.0) : 0.0 );
+    })
+);
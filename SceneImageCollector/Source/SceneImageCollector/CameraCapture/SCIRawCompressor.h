@@ -0,0 +1,98 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+
+struct ZSTD_CDict_s;
+
+// Zstd dictionary trained on the first frames of a run. Thread safe: the encoder workers hand in
+// their frames until the training set is complete, the worker that completes it trains the
+// dictionary, and every frame compressed after that uses it.
+//
+// The dictionary is a plain zstd dictionary, e.g. zstandard.ZstdCompressionDict( data ) in python.
+class FSCIRawDictionary
+{
+public:
+    FSCIRawDictionary();
+    ~FSCIRawDictionary();
+
+    // Samples are taken from InFrameCount frames; the dictionary is at most InMaxSize bytes.
+    void Initialize( const FString& InFilename, int32 InFrameCount, int32 InMaxSize, int32 InLevel );
+    void Release();
+    bool IsInitialized() const;
+    const FString& GetFilename() const;
+
+    // Called with the bytes about to be compressed, the training runs on the caller's thread.
+    void AddFrame( const uint8* InData, int64 InSize );
+    // Hands the trained dictionary out exactly once, so a single worker writes it.
+    bool TakeTrainedData( TArray64<uint8>& OutData );
+
+    // nullptr until trained.
+    const ZSTD_CDict_s* GetCompressionDictionary() const;
+    uint32 GetId() const;
+
+private:
+    void Train( TArray<uint8>&& InSamples, TArray<size_t>&& InSampleSizes );
+
+private:
+    mutable FCriticalSection Mutex;
+    FString Filename;
+    int32 FrameCount;
+    int32 MaxSize;
+    int32 Level;
+    int32 AddedFrameCount;
+    TArray<uint8> Samples;
+    TArray<size_t> SampleSizes;
+    TArray<uint8> Data;
+    ZSTD_CDict_s* CompressionDictionary;
+    uint32 Id;
+    bool IsDataTaken;
+};
+
+//-----------------------------------------------------------------------------
+
+// Lossless container for raw BGRA8 or RGBA16F frames: the header, then one standard zstd frame
+// of the pixels. Half-float pixels are byte-plane shuffled first, so the slowly changing high
+// bytes end up next to each other.
+//
+// The zstd frame records its content size, a checksum and the ID of the dictionary it was
+// compressed with, so any zstd library reads it, e.g. in python:
+//
+//   zstandard.ZstdDecompressor( dict_data=dictionary ).decompress( data[ 32: ] )
+class FSCIRawCompressor
+{
+public:
+    struct FOptions
+    {
+        // zstd level, negative levels trade ratio for speed, up to 19 for the best ratio.
+        int32 Level = 1;
+        // zstd worker threads compressing one frame, 0 compresses on the calling thread.
+        int32 WorkerCount = 0;
+        // Fed with every frame and used once trained, optional.
+        FSCIRawDictionary* Dictionary = nullptr;
+    };
+
+#pragma pack( push, 1 )
+    struct FHeader
+    {
+        ANSICHAR Magic[ 4 ] = { 'S', 'C', 'I', 'Z' };
+        uint16 Version = 2;
+        // Size of the values whose bytes are shuffled into planes, 1 = not shuffled.
+        uint8 ShuffleSize = 1;
+        int8 Level = 0;
+        int32 Width = 0;
+        int32 Height = 0;
+        int32 BytesPerPixel = 0;
+        // zstd dictionary ID, 0 when the frame was compressed without one.
+        uint32 DictionaryId = 0;
+        int64 RawSize = 0;
+    };
+#pragma pack( pop )
+
+    static_assert( sizeof( FHeader ) == 32, "The header layout is part of the file format." );
+
+    static bool IsAvailable();
+    // InBytesPerPixel is 4 for BGRA8 and 8 for RGBA16F.
+    static bool Compress( const uint8* InPixels, const FIntPoint& InResolution, int32 InBytesPerPixel, const FOptions& InOptions, TArray64<uint8>& OutData );
+    // InDictionary is the dictionary file the frame was compressed with, if any.
+    static bool Decompress( const uint8* InData, int64 InSize, TArray64<uint8>& OutPixels, FHeader* OutHeader = nullptr, TArrayView<const uint8> InDictionary = TArrayView<const uint8>() );
+};
@@ -0,0 +1,148 @@
+#include "SCIReadbackRing.h"
+#include "SCIRenderRequestTypes.h"
+#include "../VLog.h"
+#include <RHIGPUReadback.h>
+#include <RenderingThread.h>
+#include <UnrealClient.h>
+
+FSCIReadbackRing::FSCIReadbackRing()
+{
+    Resolution    = FIntPoint::ZeroValue;
+    BytesPerPixel = 0;
+    WriteIndex    = 0;
+    ReadIndex     = 0;
+    PendingCount  = 0;
+    StallCount    = 0;
+}
+
+FSCIReadbackRing::~FSCIReadbackRing()
+{
+    Release();
+}
+
+void FSCIReadbackRing::Initialize( int32 InDepth, const FIntPoint& InResolution, int32 InBytesPerPixel )
+{
+    Release();
+
+    Resolution    = InResolution;
+    BytesPerPixel = InBytesPerPixel;
+    WriteIndex    = 0;
+    ReadIndex     = 0;
+    PendingCount  = 0;
+    StallCount    = 0;
+
+    Slots.SetNum( FMath::Max( InDepth, 1 ) );
+    for ( int32 i = 0; i < Slots.Num(); i++ )
+        Slots[ i ].Readback = MakeUnique<FRHIGPUTextureReadback>( *FString::Printf( TEXT( "SCIReadback_%d" ), i ) );
+}
+
+void FSCIReadbackRing::Release()
+{
+    if ( Slots.IsEmpty() )
+        return;
+
+    // The render thread may still reference the staging textures.
+    FlushRenderingCommands();
+    Slots.Empty();
+    PendingCount = 0;
+}
+
+void FSCIReadbackRing::EnqueueCopy( FRenderTarget* InRenderTarget, FSCIRenderRequestBase* InRequest, uint8* InDestination, int32 InBytesPerPixel )
+{
+    check( IsInitialized() );
+
+    auto& slot = Slots[ WriteIndex ];
+    if ( slot.IsBusy ) {
+        // Every staging texture is still in flight, so the oldest one is mapped right away.
+        StallCount++;
+        VLOG( Warning, TEXT( "Readback ring stalled. (Depth: %d, Stalls: %d)" ), Slots.Num(), StallCount );
+        ResolveSlot( slot );
+    }
+
+    auto readback = slot.Readback.Get();
+    ENQUEUE_RENDER_COMMAND( FSCIEnqueueReadbackCommand )(
+    [readback, InRenderTarget]( FRHICommandListImmediate& RHICmdList ){
+        readback->EnqueueCopy( RHICmdList, InRenderTarget->GetRenderTargetTexture() );
+    });
+
+    // A request may receive several copies, one per captured layer.
+    InRequest->IsResolved = false;
+    InRequest->PendingCopyCount++;
+    slot.Request     = InRequest;
+    slot.Destination   = InDestination;
+    slot.BytesPerPixel = InBytesPerPixel > 0 ? InBytesPerPixel : BytesPerPixel;
+    slot.IsBusy        = true;
+
+    WriteIndex = (WriteIndex + 1) % Slots.Num();
+    PendingCount++;
+}
+
+int32 FSCIReadbackRing::Resolve()
+{
+    int32 resolvedCount = 0;
+    while ( PendingCount > 0 ) {
+        auto& slot = Slots[ ReadIndex ];
+        if ( !slot.Readback->IsReady() )
+            break;
+
+        ResolveSlot( slot );
+        resolvedCount++;
+    }
+
+    return resolvedCount;
+}
+
+void FSCIReadbackRing::ResolveSlot( FSlot& InSlot )
+{
+    auto readback    = InSlot.Readback.Get();
+    auto destination = InSlot.Destination;
+    auto resolution  = Resolution;
+    auto pixelSize   = InSlot.BytesPerPixel;
+
+    ENQUEUE_RENDER_COMMAND( FSCIResolveReadbackCommand )(
+    [readback, destination, resolution, pixelSize]( FRHICommandListImmediate& ){
+        int32 rowPitchInPixels = 0;
+        auto source = static_cast<const uint8*>( readback->Lock( rowPitchInPixels ) );
+        if ( source != nullptr ) {
+            // Staging rows may be padded, so copy row by row into the tightly packed image.
+            const int64 rowSize     = (int64)resolution.X * pixelSize;
+            const int64 sourcePitch = (int64)rowPitchInPixels * pixelSize;
+            for ( int32 y = 0; y < resolution.Y; y++ )
+                FMemory::Memcpy( destination + y * rowSize, source + y * sourcePitch, rowSize );
+        }
+        readback->Unlock();
+    });
+
+    // Render commands run in order, so the fence after the last copy covers all of them.
+    if ( --InSlot.Request->PendingCopyCount == 0 ) {
+        InSlot.Request->RenderFence.BeginFence();
+        InSlot.Request->IsResolved = true;
+    }
+
+    InSlot.Request     = nullptr;
+    InSlot.Destination = nullptr;
+    InSlot.IsBusy      = false;
+
+    ReadIndex = (ReadIndex + 1) % Slots.Num();
+    PendingCount--;
+}
+
+bool FSCIReadbackRing::IsInitialized() const
+{
+    return !Slots.IsEmpty();
+}
+
+int32 FSCIReadbackRing::GetDepth() const
+{
+    return Slots.Num();
+}
+
+int32 FSCIReadbackRing::GetPendingCount() const
+{
+    return PendingCount;
+}
+
+int32 FSCIReadbackRing::GetStallCount() const
+{
+    return StallCount;
+}
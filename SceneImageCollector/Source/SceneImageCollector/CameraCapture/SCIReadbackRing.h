@@ -0,0 +1,50 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+
+class FRenderTarget;
+class FRHIGPUTextureReadback;
+struct FSCIRenderRequestBase;
+
+// Ring of staging readbacks. The render target is copied into a free staging texture
+// and only mapped once the GPU has finished with it, so capturing never flushes the GPU
+// unless every slot is still in flight (counted as a stall).
+class FSCIReadbackRing
+{
+public:
+    FSCIReadbackRing();
+    ~FSCIReadbackRing();
+
+    void Initialize( int32 InDepth, const FIntPoint& InResolution, int32 InBytesPerPixel );
+    void Release();
+
+    // Layers of another pixel format pass their own pixel size, 0 is the ring's.
+    void EnqueueCopy( FRenderTarget* InRenderTarget, FSCIRenderRequestBase* InRequest, uint8* InDestination, int32 InBytesPerPixel = 0 );
+    int32 Resolve();
+
+    bool IsInitialized() const;
+    int32 GetDepth() const;
+    int32 GetPendingCount() const;
+    int32 GetStallCount() const;
+
+private:
+    struct FSlot
+    {
+        TUniquePtr<FRHIGPUTextureReadback> Readback;
+        FSCIRenderRequestBase* Request = nullptr;
+        uint8* Destination = nullptr;
+        int32 BytesPerPixel = 0;
+        bool IsBusy = false;
+    };
+
+    void ResolveSlot( FSlot& InSlot );
+
+private:
+    TArray<FSlot> Slots;
+    FIntPoint Resolution;
+    int32 BytesPerPixel;
+    int32 WriteIndex;
+    int32 ReadIndex;
+    int32 PendingCount;
+    int32 StallCount;
+};
@@ -1,16 +1,193 @@
 // Copyright Devcoder.
 #pragma once
 #include <CoreMinimal.h>
+#include <PixelFormat.h>
 #include <RenderCore/Public/RenderCommandFence.h>
+#include <Misc/ScopeLock.h>
 
-struct FSCIRenderRequest
+struct FSCIRenderRequestKey
 {
-    TArray<FColor> Image;
+    FIntPoint Resolution = FIntPoint::ZeroValue;
+    EPixelFormat PixelFormat = PF_Unknown;
+
+    bool operator==( const FSCIRenderRequestKey& InOther ) const
+    {
+        return (Resolution == InOther.Resolution) && (PixelFormat == InOther.PixelFormat);
+    }
+
+    friend uint32 GetTypeHash( const FSCIRenderRequestKey& InKey )
+    {
+        return HashCombine( GetTypeHash( InKey.Resolution ), GetTypeHash( (int32)InKey.PixelFormat ) );
+    }
+};
+
+struct FSCIRenderRequestBase
+{
+    FSCIRenderRequestKey Key;
     FRenderCommandFence RenderFence;
+    // Set once every staging readback of the request has been mapped and the copies fenced.
+    bool IsResolved = false;
+    int32 PendingCopyCount = 0;
+
+    bool IsReady() const
+    {
+        return IsResolved && RenderFence.IsFenceComplete();
+    }
+};
+
+struct FSCIRenderRequest : public FSCIRenderRequestBase
+{
+    static constexpr EPixelFormat PixelFormat = PF_B8G8R8A8;
+
+    TArray<FColor> Image;
 };
 
-struct FSCIFloatRenderRequest
+struct FSCIFloatRenderRequest : public FSCIRenderRequestBase
 {
+    static constexpr EPixelFormat PixelFormat = PF_FloatRGBA;
+
     TArray<FFloat16Color> Image;
-    FRenderCommandFence RenderFence;
+    // Optional auxiliary layers from the same pose, sized on demand and kept while pooled.
+    // Depth is read back from an R32f target, half floats end at 655 m.
+    TArray<float> Depth;
+    TArray<FFloat16Color> Normal;
+};
+
+// Hands a render request back once the last encode job sharing its pixels lets go of the lease.
+struct FSCIRenderRequestLease
+{
+    explicit FSCIRenderRequestLease( TUniqueFunction<void()>&& InOnReleased )
+    : OnReleased( MoveTemp( InOnReleased ) ), IsCancelled( false )
+    {
+    }
+
+    ~FSCIRenderRequestLease()
+    {
+        if ( !IsCancelled && OnReleased )
+            OnReleased();
+    }
+
+    // The request stays with its owner, e.g. when the jobs could not be submitted.
+    void Cancel()
+    {
+        IsCancelled = true;
+    }
+
+    TUniqueFunction<void()> OnReleased;
+    bool IsCancelled;
+};
+
+using FSCIRenderRequestLeasePtr = TSharedPtr<FSCIRenderRequestLease, ESPMode::ThreadSafe>;
+
+//-----------------------------------------------------------------------------
+
+// Fixed-size pool of render requests whose pixel buffers stay allocated between captures.
+// Requests are keyed by resolution and pixel format; release is safe from any thread.
+template< typename TRequest >
+class TSCIRenderRequestPool
+{
+public:
+    TSCIRenderRequestPool()
+    : Capacity( 8 ), PooledCount( 0 ), HitCount( 0 ), MissCount( 0 )
+    {
+    }
+
+    ~TSCIRenderRequestPool()
+    {
+        Empty();
+    }
+
+    void SetCapacity( int32 InCapacity )
+    {
+        FScopeLock lock( &Mutex );
+        Capacity = FMath::Max( InCapacity, 0 );
+    }
+
+    void Reserve( const FIntPoint& InResolution, int32 InCount )
+    {
+        for ( int32 i = 0; i < InCount; i++ )
+            Release( CreateRequest( MakeKey( InResolution ) ) );
+    }
+
+    TRequest* Acquire( const FIntPoint& InResolution )
+    {
+        const auto key = MakeKey( InResolution );
+        {
+            FScopeLock lock( &Mutex );
+            auto freeRequests = FreeRequests.Find( key );
+            if ( (freeRequests != nullptr) && !freeRequests->IsEmpty() ) {
+                HitCount++;
+                PooledCount--;
+                return freeRequests->Pop( false );
+            }
+            MissCount++;
+        }
+
+        return CreateRequest( key );
+    }
+
+    void Release( TRequest* InRequest )
+    {
+        if ( InRequest == nullptr )
+            return;
+
+        InRequest->IsResolved       = false;
+        InRequest->PendingCopyCount = 0;
+        {
+            FScopeLock lock( &Mutex );
+            if ( PooledCount < Capacity ) {
+                FreeRequests.FindOrAdd( InRequest->Key ).Push( InRequest );
+                PooledCount++;
+                return;
+            }
+        }
+
+        delete InRequest;
+    }
+
+    void Empty()
+    {
+        FScopeLock lock( &Mutex );
+        for ( auto& pair : FreeRequests ) {
+            for ( auto request : pair.Value )
+                delete request;
+        }
+        FreeRequests.Empty();
+        PooledCount = 0;
+    }
+
+    int32 GetHitCount() const
+    {
+        return HitCount;
+    }
+
+    int32 GetMissCount() const
+    {
+        return MissCount;
+    }
+
+private:
+    static FSCIRenderRequestKey MakeKey( const FIntPoint& InResolution )
+    {
+        FSCIRenderRequestKey key;
+        key.Resolution  = InResolution;
+        key.PixelFormat = TRequest::PixelFormat;
+        return key;
+    }
+
+    static TRequest* CreateRequest( const FSCIRenderRequestKey& InKey )
+    {
+        auto request = new TRequest();
+        request->Key = InKey;
+        request->Image.SetNumUninitialized( InKey.Resolution.X * InKey.Resolution.Y );
+        return request;
+    }
+
+private:
+    FCriticalSection Mutex;
+    TMap<FSCIRenderRequestKey, TArray<TRequest*>> FreeRequests;
+    int32 Capacity;
+    int32 PooledCount;
+    int32 HitCount;
+    int32 MissCount;
 };
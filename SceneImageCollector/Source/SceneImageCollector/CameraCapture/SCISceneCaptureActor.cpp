@@ -1,6 +1,5 @@
 #include "SCISceneCaptureActor.h"
 #include "SCISceneCaptureComponent.h"
-#include "SCIAsyncSaveImageTask.h"
 #include "SCIRenderRequestTypes.h"
 #include "../VLog.h"
 #include <Camera/CameraComponent.h>
@@ -11,11 +10,8 @@
 #include <Kismet/GameplayStatics.h>
 #include <GameFramework/PlayerInput.h>
 #include <GameFramework/InputSettings.h>
-#include <ImageWrapper/Public/IImageWrapperModule.h>
-#include <ImageWrapper/Public/IImageWrapper.h>
 #include <ImageUtils.h>
 #include <EngineUtils.h>
-#include <RHICommandList.h>
 
 ASCISceneCaptureActor::ASCISceneCaptureActor( const FObjectInitializer& ObjectInitializer )
 : Super( ObjectInitializer )
@@ -35,6 +31,62 @@ ASCISceneCaptureActor::ASCISceneCaptureActor( const FObjectInitializer& ObjectIn
     LOD              = 0;
     IsForceLODAtPlay = false;
 
+    ResolutionLadderLevels = 0;
+
+    IsUseParallelPngEncoder = true;
+    PngCompressionLevel     = 0;
+    JpgQuality              = 85;
+    JpgChromaSubsampling    = ESCIChromaSubsampling::CS_420;
+    JpgRestartInterval      = 0;
+    ExrCompressionLevel     = 4;
+    IsExrWriteAlpha         = true;
+    IsExrWriteDepth         = false;
+    IsExrWriteNormal        = false;
+    IsExrWritePreview       = false;
+    ExrPreviewFormat        = ESCIImageFormat::JPG;
+    ExrPreviewExposure      = 1.0f;
+
+    RawCompressionLevel       = 1;
+    RawCompressionWorkerCount = 0;
+    RawDictionaryFrameCount   = 0;
+    RawDictionarySizeKB       = 112;
+
+    IsAdaptiveCompression       = false;
+    AdaptiveMinCompressionLevel = 1;
+    AdaptiveMaxCompressionLevel = 6;
+    AdaptiveCompressionInterval = 0.5f;
+    AdaptiveCompressionTimer    = 0.0f;
+    CurrentPngCompressionLevel  = 0;
+    EncodeCompressionRatio      = 0.0f;
+    EncodeMegabytesPerSecond    = 0.0f;
+
+    ReadbackRingDepth  = 3;
+    ReadbackStallCount = 0;
+
+    RenderRequestPoolSize   = 8;
+    RenderRequestPoolHits   = 0;
+    RenderRequestPoolMisses = 0;
+
+    SaveTimeBudgetMs        = 4.0f;
+    RenderRequestQueueDepth = 0;
+
+    EncoderWorkerCount    = 4;
+    MaxEncodeJobsInFlight = 8;
+    WriterThreadCount     = 2;
+    MaxQueuedWrites       = 16;
+    QueuedWriteCount      = 0;
+    SubmitWouldBlockCount = 0;
+
+    IsWriteFrameArchive       = false;
+    FrameArchiveSegmentSizeMB = 4096;
+    IsWriteTarShards          = false;
+    TarShardSizeMB            = 1024;
+    IsUseWriteBehind          = false;
+    WriteBehindQueueDepth     = 16;
+    IsWriteBehindDirectIO     = false;
+    NpyFrameCapacity          = 1000;
+    IsNpyWriteAlpha           = false;
+
     EnableDefaultInputBindings = false;
     MovementSpeed = 100.0f;
     RotationSpeed = 50.0f;
@@ -55,9 +107,45 @@ void ASCISceneCaptureActor::BeginPlay()
     Super::BeginPlay();
 
     InitializeDefaultInputBindings();
-    SetupImageWrapper();
+    SetupImageEncoder();
     SetupCameraActor();
     SetupForceGlobalLOD();
+    SetupLayerCaptureComponents();
+    SetupNpyFiles();
+    SetupOutputSinks();
+    SetupReadbackRing();
+    SetupRenderRequestPool();
+}
+
+void ASCISceneCaptureActor::EndPlay( const EEndPlayReason::Type InEndPlayReason )
+{
+    ReadbackRing.Release();
+    EncoderPool.Release();
+    WriterPool.Release();
+    FrameArchive.Close();
+    TarShards.Close();
+    NpyFile.Close();
+    DepthNpyFile.Close();
+    RawDictionary.Release();
+
+    const auto encodeStats = EncoderPool.GetEncodeStats();
+    if ( encodeStats.ImageCount > 0 ) {
+        VLOG( Log, TEXT( "%s encoded %lld images: ratio %.2f, %.1f MB/s per worker." )
+        , *GetName(), encodeStats.ImageCount, encodeStats.GetCompressionRatio(), encodeStats.GetMegabytesPerSecond() );
+    }
+
+    FSCIRenderRequest* renderRequest = nullptr;
+    while ( RenderRequestQueue.Dequeue( renderRequest ) )
+        RenderRequestPool.Release( renderRequest );
+    RenderRequestPool.Empty();
+
+    FSCIFloatRenderRequest* exrRenderRequest = nullptr;
+    while ( ExrRenderRequestQueue.Dequeue( exrRenderRequest ) )
+        ExrRenderRequestPool.Release( exrRenderRequest );
+    ExrRenderRequestPool.Empty();
+    RenderRequestQueueDepth = 0;
+
+    Super::EndPlay( InEndPlayReason );
 }
 
 void ASCISceneCaptureActor::InitializeDefaultInputBindings()
@@ -150,7 +238,7 @@ void ASCISceneCaptureActor::AddLookUpOfRotation( float InValue )
 
 void ASCISceneCaptureActor::Capture()
 {
-    if ( ImageFormat == ESCIImageFormat::EXR )
+    if ( SCI::IsFloatImageFormat( ImageFormat ) )
         CaptureExrImage();
     else
         CaptureImage();
@@ -166,39 +254,37 @@ void ASCISceneCaptureActor::CaptureExrImage()
         // Get RenderContext
         auto renderTargetResource = component->TextureTarget->GameThread_GetRenderTargetResource();
 
-        // New render request
-        auto renderRequest        = new FSCIFloatRenderRequest();
-
-        // Read the render target surface data back.
-        struct FSCIReadSurfaceFloatContext
-        {
-            FRenderTarget* SrcRenderTarget;
-            TArray<FFloat16Color>* OutData;
-            FIntRect Rect;
-            ECubeFace CubeFace;
-        };
-
-        // Setup GPU command
-        FSCIReadSurfaceFloatContext context = {
-            renderTargetResource,
-            &(renderRequest->Image),
-            FIntRect( 0, 0, RenderResolution.X, RenderResolution.Y ),
-            ECubeFace::CubeFace_MAX // No cubeface
-        };
-
-        ENQUEUE_RENDER_COMMAND( FSCIReadSurfaceCommand )(
-        [context]( FRHICommandListImmediate& RHICmdList ){
-            RHICmdList.ReadSurfaceFloatData(
-                context.SrcRenderTarget->GetRenderTargetTexture(), 
-                context.Rect, 
-                *context.OutData, 
-                context.CubeFace, 
-                0, 
-                0 );
-        });
+        // Recycled render request with a pre-sized pixel buffer
+        auto renderRequest        = ExrRenderRequestPool.Acquire( RenderResolution );
 
+        // Copy into a staging readback, mapped later once the GPU is done with it.
         ExrRenderRequestQueue.Enqueue( renderRequest );
-        renderRequest->RenderFence.BeginFence();
+        RenderRequestQueueDepth++;
+        ReadbackRing.EnqueueCopy( renderTargetResource, renderRequest, reinterpret_cast<uint8*>( renderRequest->Image.GetData() ) );
+
+        // Auxiliary layers share the request, it becomes ready once every copy is resolved.
+        const auto pixelCount = RenderResolution.X * RenderResolution.Y;
+        if ( DepthCaptureComponent != nullptr ) {
+            DepthCaptureComponent->CaptureScene();
+            if ( renderRequest->Depth.Num() != pixelCount )
+                renderRequest->Depth.SetNumUninitialized( pixelCount );
+            ReadbackRing.EnqueueCopy( DepthCaptureComponent->TextureTarget->GameThread_GetRenderTargetResource(), renderRequest
+            , reinterpret_cast<uint8*>( renderRequest->Depth.GetData() ), sizeof( float ) );
+        }
+        else {
+            renderRequest->Depth.Empty();
+        }
+
+        if ( NormalCaptureComponent != nullptr ) {
+            NormalCaptureComponent->CaptureScene();
+            if ( renderRequest->Normal.Num() != pixelCount )
+                renderRequest->Normal.SetNumUninitialized( pixelCount );
+            ReadbackRing.EnqueueCopy( NormalCaptureComponent->TextureTarget->GameThread_GetRenderTargetResource(), renderRequest
+            , reinterpret_cast<uint8*>( renderRequest->Normal.GetData() ) );
+        }
+        else {
+            renderRequest->Normal.Empty();
+        }
     }
 }
 
@@ -212,37 +298,13 @@ void ASCISceneCaptureActor::CaptureImage()
         // Get RenderContext
         auto renderTargetResource = component->TextureTarget->GameThread_GetRenderTargetResource();
 
-        // New render request
-        auto renderRequest        = new FSCIRenderRequest();
-
-        // Read the render target surface data back.
-        struct FSCIReadSurfaceContext
-        {
-            FRenderTarget* SrcRenderTarget;
-            TArray<FColor>* OutData;
-            FIntRect Rect;
-            FReadSurfaceDataFlags Flags;
-        };
-
-        // Setup GPU command
-        FSCIReadSurfaceContext context = {
-            renderTargetResource,
-            &(renderRequest->Image),
-            FIntRect( 0, 0, RenderResolution.X, RenderResolution.Y ),
-            FReadSurfaceDataFlags( RCM_UNorm, CubeFace_MAX )
-        };
-
-        ENQUEUE_RENDER_COMMAND( FSCIReadSurfaceCommand )(
-        [context]( FRHICommandListImmediate& RHICmdList ){
-            RHICmdList.ReadSurfaceData(
-                context.SrcRenderTarget->GetRenderTargetTexture(), 
-                context.Rect, 
-                *context.OutData, 
-                context.Flags );
-        });
+        // Recycled render request with a pre-sized pixel buffer
+        auto renderRequest        = RenderRequestPool.Acquire( RenderResolution );
 
+        // Copy into a staging readback, mapped later once the GPU is done with it.
         RenderRequestQueue.Enqueue( renderRequest );
-        renderRequest->RenderFence.BeginFence();
+        RenderRequestQueueDepth++;
+        ReadbackRing.EnqueueCopy( renderTargetResource, renderRequest, reinterpret_cast<uint8*>( renderRequest->Image.GetData() ) );
     }
 }
 
@@ -264,17 +326,122 @@ void ASCISceneCaptureActor::ResetGlobalLOD()
     }
 }
 
-void ASCISceneCaptureActor::SetupImageWrapper()
+void ASCISceneCaptureActor::SetupImageEncoder()
+{
+    // A codec left out of this build is refused before capturing instead of failing every frame.
+    if ( !FSCIImageEncoderRegistry::Get( ImageFormat ).CanEncode( SCI::GetCaptureFormat( ImageFormat ) ) ) {
+        VLOG( Error, TEXT( "%s: %s is not available in this build, RAW is written instead." ), *GetName(), *UEnum::GetValueAsString( ImageFormat ) );
+        ImageFormat = ESCIImageFormat::RAW;
+    }
+
+    CurrentPngCompressionLevel = IsAdaptiveCompression 
+    ? FMath::Clamp( PngCompressionLevel, AdaptiveMinCompressionLevel, AdaptiveMaxCompressionLevel ) 
+    : PngCompressionLevel;
+
+    // One archive or shard set per actor, so several actors can capture into the same directory.
+    const auto baseFilename = FPaths::ProjectSavedDir() / SubDirectoryName / GetName();
+    ISCIFrameContainer* container = nullptr;
+    if ( IsWriteFrameArchive ) {
+        if ( FrameArchive.Open( baseFilename, FPaths::ProjectSavedDir(), (int64)FrameArchiveSegmentSizeMB << 20 ) )
+            container = &FrameArchive;
+    }
+    else if ( IsWriteTarShards ) {
+        if ( TarShards.Open( baseFilename, FPaths::ProjectSavedDir(), (int64)TarShardSizeMB << 20 ) )
+            container = &TarShards;
+    }
+
+    FSCIUringFileWriter::FOptions writeBehind;
+    writeBehind.QueueDepth = WriteBehindQueueDepth;
+    writeBehind.IsDirectIO = IsWriteBehindDirectIO;
+
+    // One dictionary per actor, shared by every output that uses one and written next to its frames.
+    const auto isUsingDictionary = FSCIImageEncoderRegistry::Get( ImageFormat ).IsUsingDictionary() 
+    || OutputSinks.ContainsByPredicate( []( const FSCIOutputSink& InSink ){ return FSCIImageEncoderRegistry::Get( InSink.ImageFormat ).IsUsingDictionary(); } );
+    if ( isUsingDictionary && (RawDictionaryFrameCount > 0) )
+        RawDictionary.Initialize( baseFilename + TEXT( ".zdict" ), RawDictionaryFrameCount, RawDictionarySizeKB * 1024, RawCompressionLevel );
+
+    WriterPool.Initialize( WriterThreadCount, MaxQueuedWrites, container, IsUseWriteBehind ? &writeBehind : nullptr );
+    EncoderPool.Initialize( EncoderWorkerCount, MaxEncodeJobsInFlight, &WriterPool );
+}
+
+void ASCISceneCaptureActor::SetupReadbackRing()
+{
+    const auto bytesPerPixel = SCI::GetCaptureBytesPerPixel( SCI::GetCaptureFormat( ImageFormat ) );
+    // Every exr layer takes its own staging slot.
+    ReadbackRing.Initialize( ReadbackRingDepth * GetExrLayerCount(), RenderResolution, bytesPerPixel );
+}
+
+void ASCISceneCaptureActor::SetupLayerCaptureComponents()
+{
+    // Npy only has room for the depth next to the color frames.
+    const auto& encoder = FSCIImageEncoderRegistry::Get( ImageFormat );
+    if ( IsExrWriteDepth && encoder.IsDepthLayerSupported() )
+        DepthCaptureComponent = CreateLayerCaptureComponent( TEXT( "DepthCaptureComponent" ), ESceneCaptureSource::SCS_SceneDepth );
+    if ( IsExrWriteNormal && encoder.IsNormalLayerSupported() )
+        NormalCaptureComponent = CreateLayerCaptureComponent( TEXT( "NormalCaptureComponent" ), ESceneCaptureSource::SCS_Normal );
+}
+
+USCISceneCaptureComponent* ASCISceneCaptureActor::CreateLayerCaptureComponent( const TCHAR* InName, ESceneCaptureSource InCaptureSource )
+{
+    auto component = NewObject<USCISceneCaptureComponent>( this, FName( InName ) );
+    component->SetOwnerSceneCapture( this );
+    component->CaptureSource       = InCaptureSource;
+    // Layers are only rendered together with the color capture.
+    component->bCaptureEveryFrame  = false;
+    component->bCaptureOnMovement  = false;
+    component->SetupAttachment( RootComponent );
+    component->RegisterComponent();
+    return component;
+}
+
+void ASCISceneCaptureActor::SetupOutputSinks()
+{
+    // A sink can only encode what the capture reads back, 8-bit or half-float pixels.
+    ActiveOutputSinks.Reset();
+    const auto captureFormat = SCI::GetCaptureFormat( ImageFormat );
+    for ( const auto& sink : OutputSinks ) {
+        if ( FSCIImageEncoderRegistry::Get( sink.ImageFormat ).IsPrimaryOnly() ) {
+            VLOG( Warning, TEXT( "Output sink %s only works as the image format of the actor, skipped." ), *UEnum::GetValueAsString( sink.ImageFormat ) );
+            continue;
+        }
+        if ( !FSCIImageEncoderRegistry::Get( sink.ImageFormat ).CanEncode( captureFormat ) ) {
+            VLOG( Warning, TEXT( "Output sink %s does not match the capture format %s, skipped." )
+            , *UEnum::GetValueAsString( sink.ImageFormat ), *UEnum::GetValueAsString( ImageFormat ) );
+            continue;
+        }
+        ActiveOutputSinks.Add( sink );
+    }
+}
+
+void ASCISceneCaptureActor::SetupNpyFiles()
+{
+    if ( !FSCIImageEncoderRegistry::Get( ImageFormat ).IsWritingNpyFile() )
+        return;
+
+    const auto baseFilename = FPaths::ProjectSavedDir() / SubDirectoryName / GetName();
+    const auto elementType  = SCI::IsFloatImageFormat( ImageFormat ) ? FSCINpyWriter::EElementType::Float16 : FSCINpyWriter::EElementType::UInt8;
+    NpyFile.Open( baseFilename + GetImageExtension(), elementType, RenderResolution, IsNpyWriteAlpha ? 4 : 3, NpyFrameCapacity );
+    if ( DepthCaptureComponent != nullptr )
+        DepthNpyFile.Open( baseFilename + TEXT( "_depth" ) + GetImageExtension(), FSCINpyWriter::EElementType::Float32, RenderResolution, 1, NpyFrameCapacity );
+}
+
+int32 ASCISceneCaptureActor::GetExrLayerCount() const
 {
-    // Load the image wrapper module
-    auto& imageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>( FName( TEXT( "ImageWrapper" ) ) );
+    return 1 + (DepthCaptureComponent != nullptr ? 1 : 0) + (NormalCaptureComponent != nullptr ? 1 : 0);
+}
 
-    if ( ImageFormat == ESCIImageFormat::PNG )
-        ImageWrapper = imageWrapperModule.CreateImageWrapper( EImageFormat::PNG );
-    else if ( ImageFormat == ESCIImageFormat::JPG )
-        ImageWrapper = imageWrapperModule.CreateImageWrapper( EImageFormat::JPEG );
-    else if ( ImageFormat == ESCIImageFormat::EXR )
-        ImageWrapper = imageWrapperModule.CreateImageWrapper( EImageFormat::EXR );
+void ASCISceneCaptureActor::SetupRenderRequestPool()
+{
+    // Every ring slot and every encode job in flight can hold a request at the same time.
+    const auto capacity = FMath::Max( RenderRequestPoolSize, ReadbackRingDepth + MaxEncodeJobsInFlight );
+    if ( SCI::IsFloatImageFormat( ImageFormat ) ) {
+        ExrRenderRequestPool.SetCapacity( capacity );
+        ExrRenderRequestPool.Reserve( RenderResolution, ReadbackRingDepth + 1 );
+    }
+    else {
+        RenderRequestPool.SetCapacity( capacity );
+        RenderRequestPool.Reserve( RenderResolution, ReadbackRingDepth + 1 );
+    }
 }
 
 void ASCISceneCaptureActor::SetupCameraActor()
@@ -325,56 +492,232 @@ void ASCISceneCaptureActor::Tick( float InDeltaTime )
 {
     Super::Tick( InDeltaTime );
 
-    if ( ImageFormat == ESCIImageFormat::EXR )
-        SaveExrImage();
+    ReadbackRing.Resolve();
+    ReadbackStallCount = ReadbackRing.GetStallCount();
+
+    UpdateAdaptiveCompression( InDeltaTime );
+
+    // Drain every completed readback, bounded by the per-tick time budget.
+    const auto deadline = FPlatformTime::Seconds() + SaveTimeBudgetMs / 1000.0;
+    if ( SCI::IsFloatImageFormat( ImageFormat ) )
+        SaveExrImage( deadline );
     else 
-        SaveImage();
+        SaveImage( deadline );
+
+    RenderRequestPoolHits   = RenderRequestPool.GetHitCount() + ExrRenderRequestPool.GetHitCount();
+    RenderRequestPoolMisses = RenderRequestPool.GetMissCount() + ExrRenderRequestPool.GetMissCount();
+    QueuedWriteCount        = WriterPool.GetQueuedCount();
+
+    const auto encodeStats   = EncoderPool.GetEncodeStats();
+    EncodeCompressionRatio   = encodeStats.GetCompressionRatio();
+    EncodeMegabytesPerSecond = encodeStats.GetMegabytesPerSecond();
 }
 
-void ASCISceneCaptureActor::SaveExrImage()
+void ASCISceneCaptureActor::SaveExrImage( double InDeadline )
 {
-    if ( !ExrRenderRequestQueue.IsEmpty() ) {
+    while ( !ExrRenderRequestQueue.IsEmpty() ) {
         // Peek the next render request from queue.
         FSCIFloatRenderRequest* nextRenderRequest = nullptr;
         ExrRenderRequestQueue.Peek( nextRenderRequest );
-        if ( (nextRenderRequest != nullptr) && nextRenderRequest->RenderFence.IsFenceComplete() ) {
-            auto fileName = FPaths::ProjectSavedDir() + SubDirectoryName + TEXT( "/img" ) + TEXT( "_" ) + ToStringWithLeadingZeros( ImageCounter );
-            fileName     += TEXT( ".exr" );
+        if ( (nextRenderRequest == nullptr) || !nextRenderRequest->IsReady() )
+            break;
+
+        // The request goes back to the pool once the primary output and every sink are done with it.
+        FSCIRenderRequestLeasePtr lease = MakeShared<FSCIRenderRequestLease, ESPMode::ThreadSafe>(
+        [pool = &ExrRenderRequestPool, nextRenderRequest]{ pool->Release( nextRenderRequest ); } );
+
+        const auto baseName = MakeBaseFileName( SubDirectoryName );
+
+        // Compression and the file write run on the encoder workers.
+        FSCIEncodeJob job;
+        job.RawData     = nextRenderRequest->Image.GetData();
+        job.RawSize     = nextRenderRequest->Image.Num() * sizeof( FFloat16Color );
+        job.Resolution  = RenderResolution;
+        job.RGBFormat   = ERGBFormat::RGBAF;
+        job.BitDepth    = 16;
+        FillEncodeSettings( ImageFormat, job );
+        job.NpyFile      = NpyFile.IsOpen() ? &NpyFile : nullptr;
+        job.DepthNpyFile = DepthNpyFile.IsOpen() ? &DepthNpyFile : nullptr;
+        job.LadderLevels = FSCIImageEncoderRegistry::Get( ImageFormat ).IsResolutionLadderSupported() ? ResolutionLadderLevels : 0;
+        job.FrameId     = ImageCounter;
+        job.DepthData   = nextRenderRequest->Depth.IsEmpty() ? nullptr : nextRenderRequest->Depth.GetData();
+        job.NormalData  = nextRenderRequest->Normal.IsEmpty() ? nullptr : nextRenderRequest->Normal.GetData();
+        if ( IsExrWritePreview && FSCIImageEncoderRegistry::Get( ImageFormat ).IsPreviewSupported() ) {
+            // Only the 8-bit formats make sense for a preview.
+            const auto previewFormat = ((ExrPreviewFormat == ESCIImageFormat::JPG) || (ExrPreviewFormat == ESCIImageFormat::QOI)) 
+            ? ExrPreviewFormat 
+            : ESCIImageFormat::PNG;
+            job.PreviewFilename = baseName + TEXT( "_preview" ) + GetImageExtension( previewFormat );
+            job.PreviewFormat   = previewFormat;
+            job.PreviewQuality  = JpgQuality;
+            job.PreviewExposure = ExrPreviewExposure;
+        }
+        job.Filename    = baseName + GetImageExtension();
+        job.OnFinished  = [lease]() mutable { lease.Reset(); };
+
+        TArray<FSCIEncodeJob> jobs;
+        AddOutputSinkJobs( job, lease, jobs );
+        jobs.Add( MoveTemp( job ) );
+        if ( EncoderPool.TrySubmit( jobs ) == ESCISubmitResult::WouldBlock ) {
+            // The pipeline is saturated, keep the request queued until the next tick.
+            lease->Cancel();
+            SubmitWouldBlockCount++;
+            break;
+        }
 
-            ImageWrapper->SetRaw( nextRenderRequest->Image.GetData(), nextRenderRequest->Image.GetAllocatedSize(), RenderResolution.X, RenderResolution.Y, ERGBFormat::RGBAF, 16 );
-            const auto& imageData = ImageWrapper->GetCompressed( (int32)EImageCompressionQuality::Uncompressed );
-            AsyncSaveImageTask( imageData, fileName );
+        ImageCounter++;
 
-            ImageCounter++;
+        // Remove the first element from render request, the encoder returns it to the pool.
+        ExrRenderRequestQueue.Pop();
+        RenderRequestQueueDepth--;
 
-            // Delete the first element from render request.
-            ExrRenderRequestQueue.Pop();
-            delete nextRenderRequest;
-        }
+        if ( IsSaveTimeBudgetExceeded( InDeadline ) )
+            break;
     }
 }
 
-void ASCISceneCaptureActor::SaveImage()
+void ASCISceneCaptureActor::SaveImage( double InDeadline )
 {
-    if ( !RenderRequestQueue.IsEmpty() ) {
+    while ( !RenderRequestQueue.IsEmpty() ) {
         // Peek the next render request from queue.
         FSCIRenderRequest* nextRenderRequest = nullptr;
         RenderRequestQueue.Peek( nextRenderRequest );
-        if ( (nextRenderRequest != nullptr) && nextRenderRequest->RenderFence.IsFenceComplete() ) {
-            auto fileName = FPaths::ProjectSavedDir() + SubDirectoryName + TEXT( "/img" ) + TEXT( "_" ) + ToStringWithLeadingZeros( ImageCounter );
-            fileName += (ImageFormat == ESCIImageFormat::PNG ? TEXT( ".png" ) : TEXT( ".jpeg" ));
+        if ( (nextRenderRequest == nullptr) || !nextRenderRequest->IsReady() )
+            break;
+
+        // The request goes back to the pool once the primary output and every sink are done with it.
+        FSCIRenderRequestLeasePtr lease = MakeShared<FSCIRenderRequestLease, ESPMode::ThreadSafe>(
+        [pool = &RenderRequestPool, nextRenderRequest]{ pool->Release( nextRenderRequest ); } );
+
+        // Compression and the file write run on the encoder workers.
+        FSCIEncodeJob job;
+        job.RawData     = nextRenderRequest->Image.GetData();
+        job.RawSize     = nextRenderRequest->Image.Num() * sizeof( FColor );
+        job.Resolution  = RenderResolution;
+        job.RGBFormat   = ERGBFormat::BGRA;
+        job.BitDepth    = 8;
+        FillEncodeSettings( ImageFormat, job );
+        job.NpyFile      = NpyFile.IsOpen() ? &NpyFile : nullptr;
+        job.LadderLevels = FSCIImageEncoderRegistry::Get( ImageFormat ).IsResolutionLadderSupported() ? ResolutionLadderLevels : 0;
+        job.FrameId     = ImageCounter;
+        job.Filename    = MakeBaseFileName( SubDirectoryName ) + GetImageExtension();
+        job.OnFinished  = [lease]() mutable { lease.Reset(); };
+
+        TArray<FSCIEncodeJob> jobs;
+        AddOutputSinkJobs( job, lease, jobs );
+        jobs.Add( MoveTemp( job ) );
+        if ( EncoderPool.TrySubmit( jobs ) == ESCISubmitResult::WouldBlock ) {
+            // The pipeline is saturated, keep the request queued until the next tick.
+            lease->Cancel();
+            SubmitWouldBlockCount++;
+            break;
+        }
 
-            ImageWrapper->SetRaw( nextRenderRequest->Image.GetData(), nextRenderRequest->Image.GetAllocatedSize(), RenderResolution.X, RenderResolution.Y, ERGBFormat::BGRA, 8 );
-            const auto& imageData = ImageWrapper->GetCompressed( ImageFormat == ESCIImageFormat::PNG ? (int32)EImageCompressionQuality::Uncompressed : 0 );
-            AsyncSaveImageTask( imageData, fileName );
+        ImageCounter++;
 
-            ImageCounter++;
+        // Remove the first element from render request, the encoder returns it to the pool.
+        RenderRequestQueue.Pop();
+        RenderRequestQueueDepth--;
 
-            // Delete the first element from render request.
-            RenderRequestQueue.Pop();
-            delete nextRenderRequest;
-        }
+        if ( IsSaveTimeBudgetExceeded( InDeadline ) )
+            break;
+    }
+}
+
+void ASCISceneCaptureActor::AddOutputSinkJobs( const FSCIEncodeJob& InPrimaryJob, const FSCIRenderRequestLeasePtr& InLease, TArray<FSCIEncodeJob>& OutJobs )
+{
+    for ( const auto& sink : ActiveOutputSinks ) {
+        FSCIEncodeJob job;
+        job.RawData          = InPrimaryJob.RawData;
+        job.RawSize          = InPrimaryJob.RawSize;
+        job.Resolution       = InPrimaryJob.Resolution;
+        job.RGBFormat        = InPrimaryJob.RGBFormat;
+        job.BitDepth         = InPrimaryJob.BitDepth;
+        job.OutputResolution = sink.Resolution;
+        job.FrameId          = InPrimaryJob.FrameId;
+        FillEncodeSettings( sink.ImageFormat, job );
+
+        // Rescaled outputs carry their size, so they never collide with a full-size file.
+        job.Filename = MakeBaseFileName( sink.SubDirectoryName.IsEmpty() ? SubDirectoryName : sink.SubDirectoryName );
+        if ( (sink.Resolution.X > 0) && (sink.Resolution.Y > 0) && (sink.Resolution != RenderResolution) )
+            job.Filename += FString::Printf( TEXT( "_%dx%d" ), sink.Resolution.X, sink.Resolution.Y );
+        job.Filename += GetImageExtension( sink.ImageFormat );
+
+        job.OnFinished = [lease = InLease]() mutable { lease.Reset(); };
+        OutJobs.Add( MoveTemp( job ) );
+    }
+}
+
+void ASCISceneCaptureActor::FillEncodeSettings( ESCIImageFormat InImageFormat, FSCIEncodeJob& OutJob )
+{
+    // Each format picks its own quality and level from the capture's settings.
+    const auto& encoder = FSCIImageEncoderRegistry::Get( InImageFormat );
+    const auto settings = GetEncodeSettings();
+    OutJob.ImageFormat            = InImageFormat;
+    OutJob.Quality                = encoder.GetQuality( settings );
+    OutJob.CompressionLevel       = encoder.GetCompressionLevel( settings );
+    OutJob.CompressionWorkerCount = RawCompressionWorkerCount;
+    OutJob.RawDictionary          = encoder.IsUsingDictionary() && RawDictionary.IsInitialized() ? &RawDictionary : nullptr;
+    OutJob.IsUseParallelPng       = IsUseParallelPngEncoder;
+    OutJob.IsChromaSubsampled     = JpgChromaSubsampling == ESCIChromaSubsampling::CS_420;
+    OutJob.RestartInterval        = JpgRestartInterval;
+    OutJob.IsWriteAlpha           = IsExrWriteAlpha;
+}
+
+FString ASCISceneCaptureActor::MakeBaseFileName( const FString& InSubDirectoryName )
+{
+    return FPaths::ProjectSavedDir() + InSubDirectoryName + TEXT( "/img" ) + TEXT( "_" ) + ToStringWithLeadingZeros( ImageCounter );
+}
+
+const TCHAR* ASCISceneCaptureActor::GetImageExtension() const
+{
+    return GetImageExtension( ImageFormat );
+}
+
+const TCHAR* ASCISceneCaptureActor::GetImageExtension( ESCIImageFormat InImageFormat ) const
+{
+    return FSCIImageEncoderRegistry::Get( InImageFormat ).GetExtension();
+}
+
+FSCIEncodeSettings ASCISceneCaptureActor::GetEncodeSettings() const
+{
+    // The png level follows the adaptive compression.
+    FSCIEncodeSettings settings;
+    settings.JpgQuality          = JpgQuality;
+    settings.PngCompressionLevel = CurrentPngCompressionLevel;
+    settings.ExrCompressionLevel = ExrCompressionLevel;
+    settings.RawCompressionLevel = RawCompressionLevel;
+    return settings;
+}
+
+void ASCISceneCaptureActor::UpdateAdaptiveCompression( float InDeltaTime )
+{
+    const auto minLevel = FMath::Clamp( AdaptiveMinCompressionLevel, 0, 9 );
+    const auto maxLevel = FMath::Clamp( AdaptiveMaxCompressionLevel, minLevel, 9 );
+    if ( !IsAdaptiveCompression ) {
+        CurrentPngCompressionLevel = FMath::Clamp( PngCompressionLevel, 0, 9 );
+        return;
     }
+
+    AdaptiveCompressionTimer += InDeltaTime;
+    if ( AdaptiveCompressionTimer < AdaptiveCompressionInterval )
+        return;
+    AdaptiveCompressionTimer = 0.0f;
+
+    // Spend idle CPU on smaller files, and back off as soon as the encoders fall behind.
+    const auto backlog = RenderRequestQueueDepth + EncoderPool.GetInFlightCount();
+    const auto fill    = (float)backlog / FMath::Max( MaxEncodeJobsInFlight, 1 );
+    if ( fill >= 0.75f )
+        CurrentPngCompressionLevel = FMath::Max( CurrentPngCompressionLevel - 1, minLevel );
+    else if ( fill <= 0.25f )
+        CurrentPngCompressionLevel = FMath::Min( CurrentPngCompressionLevel + 1, maxLevel );
+    else
+        CurrentPngCompressionLevel = FMath::Clamp( CurrentPngCompressionLevel, minLevel, maxLevel );
+}
+
+bool ASCISceneCaptureActor::IsSaveTimeBudgetExceeded( double InDeadline ) const
+{
+    return (SaveTimeBudgetMs > 0.0f) && (FPlatformTime::Seconds() >= InDeadline);
 }
 
 FString ASCISceneCaptureActor::ToStringWithLeadingZeros( int32 InIndex )
@@ -394,12 +737,6 @@ FString ASCISceneCaptureActor::ToStringWithLeadingZeros( int32 InIndex )
     return leadingZeros + result;
 }
 
-void ASCISceneCaptureActor::AsyncSaveImageTask( const TArray64<uint8>& InImage, const FString& InImageName )
-{
-    VLOG( Log, TEXT( "Running Async Task." ) );
-    (new FAutoDeleteAsyncTask<FSCIAsyncSaveImageTask>( InImage, InImageName ))->StartBackgroundTask();
-}
-
 UCameraComponent* ASCISceneCaptureActor::GetCameraComponent() const
 {
     return CameraActor.IsValid() ? CameraActor->GetCameraComponent() : nullptr;
@@ -410,6 +747,22 @@ FIntPoint ASCISceneCaptureActor::GetRenderResolution() const
     return RenderResolution;
 }
 
+int32 ASCISceneCaptureActor::GetReadbackStallCount() const
+{
+    return ReadbackStallCount;
+}
+
+int32 ASCISceneCaptureActor::GetRenderRequestQueueDepth() const
+{
+    return RenderRequestQueueDepth;
+}
+
+int32 ASCISceneCaptureActor::GetInFlightFrameCount() const
+{
+    // Frames waiting for readback or saving, being encoded, or waiting to be written.
+    return RenderRequestQueueDepth + EncoderPool.GetInFlightCount() + WriterPool.GetQueuedCount();
+}
+
 ESCIImageFormat ASCISceneCaptureActor::GetImageFormat() const
 {
     return ImageFormat;
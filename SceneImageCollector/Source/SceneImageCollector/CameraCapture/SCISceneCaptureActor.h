@@ -1,14 +1,39 @@
 // Copyright Devcoder.
 #pragma once
+#include "SCIReadbackRing.h"
+#include "SCIRenderRequestTypes.h"
+#include "SCIImageEncoder.h"
+#include "SCIImageEncoderRegistry.h"
+#include "SCIImageFormat.h"
+#include "SCIFrameArchive.h"
+#include "SCINpyWriter.h"
+#include "SCIRawCompressor.h"
+#include "SCITarShardWriter.h"
 #include <GameFramework/Actor.h>
 #include "SCISceneCaptureActor.generated.h"
 
 UENUM()
-enum class ESCIImageFormat
+enum class ESCIChromaSubsampling
 {
-    PNG,
-    JPG,
-    EXR
+    CS_420 UMETA(DisplayName="4:2:0"),
+    CS_444 UMETA(DisplayName="4:4:4")
+};
+
+// Extra output encoded from the same readback as the actor's own ImageFormat.
+USTRUCT()
+struct FSCIOutputSink
+{
+    GENERATED_BODY()
+
+    // Must match the capture: PNG, JPG, QOI or RAW for 8-bit, EXR, PNG16 or RAW for float formats.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture" )
+    ESCIImageFormat ImageFormat = ESCIImageFormat::PNG;
+    // Zero keeps the render resolution.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture" )
+    FIntPoint Resolution = FIntPoint::ZeroValue;
+    // Empty keeps the actor's SubDirectoryName.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture" )
+    FString SubDirectoryName;
 };
 
 UCLASS( Blueprintable, ClassGroup=(CameraSystem) ) 
@@ -24,23 +49,41 @@ public:
 
     class UCameraComponent* GetCameraComponent() const;
     FIntPoint GetRenderResolution() const;
+    int32 GetReadbackStallCount() const;
+    int32 GetRenderRequestQueueDepth() const;
+    int32 GetInFlightFrameCount() const;
     ESCIImageFormat GetImageFormat() const;
 
 protected:
     virtual void BeginPlay() override;
+    virtual void EndPlay( const EEndPlayReason::Type InEndPlayReason ) override;
 
 private:
     void SetupCameraActor();
-    void SetupImageWrapper();
+    void SetupImageEncoder();
     void SetupForceGlobalLOD();
+    void SetupReadbackRing();
+    void SetupRenderRequestPool();
+    void SetupLayerCaptureComponents();
+    void SetupOutputSinks();
+    void SetupNpyFiles();
+    class USCISceneCaptureComponent* CreateLayerCaptureComponent( const TCHAR* InName, ESceneCaptureSource InCaptureSource );
+    int32 GetExrLayerCount() const;
 
     void CaptureImage();
     void CaptureExrImage();
 
-    void SaveImage();
-    void SaveExrImage();
+    void SaveImage( double InDeadline );
+    void SaveExrImage( double InDeadline );
+    bool IsSaveTimeBudgetExceeded( double InDeadline ) const;
+    FSCIEncodeSettings GetEncodeSettings() const;
+    void FillEncodeSettings( ESCIImageFormat InImageFormat, FSCIEncodeJob& OutJob );
+    void AddOutputSinkJobs( const FSCIEncodeJob& InPrimaryJob, const FSCIRenderRequestLeasePtr& InLease, TArray<FSCIEncodeJob>& OutJobs );
+    FString MakeBaseFileName( const FString& InSubDirectoryName );
+    const TCHAR* GetImageExtension() const;
+    const TCHAR* GetImageExtension( ESCIImageFormat InImageFormat ) const;
+    void UpdateAdaptiveCompression( float InDeltaTime );
 
-    void AsyncSaveImageTask( const TArray64<uint8>& InImage, const FString& InImageName );
     FString ToStringWithLeadingZeros( int32 InIndex );
 
     void InitializeDefaultInputBindings();
@@ -61,13 +104,134 @@ private:
     int32 MaxDigits;
     UPROPERTY( EditAnywhere, Category="SCI|Capture" )
     FIntPoint RenderResolution;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(ClampMin=1, UIMin=1) )
+    int32 ReadbackRingDepth;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(ClampMin=1, UIMin=1) )
+    int32 RenderRequestPoolSize;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(ClampMin=0, UIMin=0, Units="ms") )
+    float SaveTimeBudgetMs;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(ClampMin=1, UIMin=1) )
+    int32 EncoderWorkerCount;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(ClampMin=1, UIMin=1) )
+    int32 MaxEncodeJobsInFlight;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(ClampMin=1, UIMin=1) )
+    int32 WriterThreadCount;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(ClampMin=1, UIMin=1) )
+    int32 MaxQueuedWrites;
+    // Packs every output into a few large segment files plus an index instead of one file per image.
+    // SCI.ExtractFrameArchive turns it back into files.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture" )
+    bool IsWriteFrameArchive;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="IsWriteFrameArchive", ClampMin=1, UIMin=1, Units="MB") )
+    int32 FrameArchiveSegmentSizeMB;
+    // Streams every output with its json metadata into rolling WebDataset .tar shards named after the actor.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="!IsWriteFrameArchive") )
+    bool IsWriteTarShards;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="IsWriteTarShards", ClampMin=1, UIMin=1, Units="MB") )
+    int32 TarShardSizeMB;
+    // Plain files are written through io_uring on Linux, several per system call. Elsewhere, or when the
+    // kernel refuses it, the writer threads are used as before.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="!IsWriteFrameArchive && !IsWriteTarShards") )
+    bool IsUseWriteBehind;
+    // Files in flight, at most MaxQueuedWrites since the writer never queues more.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="IsUseWriteBehind", ClampMin=1, UIMin=1, ClampMax=4096) )
+    int32 WriteBehindQueueDepth;
+    // Files of a megabyte and more bypass the page cache.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="IsUseWriteBehind") )
+    bool IsWriteBehindDirectIO;
+    // NPY and NPY16 write every frame into one <Actor>.npy preallocated for this many frames, later frames are dropped.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(ClampMin=1, UIMin=1) )
+    int32 NpyFrameCapacity;
+    // RGBA instead of RGB.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture" )
+    bool IsNpyWriteAlpha;
     UPROPERTY( EditAnywhere, Category="SCI|Capture" )
     ESCIImageFormat ImageFormat;
     UPROPERTY( EditAnywhere, Category="SCI|Capture" )
+    TArray<FSCIOutputSink> OutputSinks;
+    // Halved copies written next to every frame, e.g. 2 levels of 1920x1080 add 960x540 and 480x270.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(ClampMin=0, UIMin=0, UIMax=4) )
+    int32 ResolutionLadderLevels;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="ImageFormat==ESCIImageFormat::PNG") )
+    bool IsUseParallelPngEncoder;
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(ClampMin=0, ClampMax=9, UIMin=0, UIMax=9) )
+    int32 PngCompressionLevel;
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(ClampMin=1, ClampMax=100, UIMin=1, UIMax=100) )
+    int32 JpgQuality;
+    UPROPERTY( EditAnywhere, Category="SCI|Compression" )
+    ESCIChromaSubsampling JpgChromaSubsampling;
+    // MCU rows per restart interval, every interval is encoded on its own core. 0 = one per core.
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(ClampMin=0, UIMin=0) )
+    int32 JpgRestartInterval;
+    // zlib level of the exr ZIP blocks, 0 writes uncompressed scanlines.
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(ClampMin=0, ClampMax=9, UIMin=0, UIMax=9) )
+    int32 ExrCompressionLevel;
+    UPROPERTY( EditAnywhere, Category="SCI|Compression" )
+    bool IsExrWriteAlpha;
+    // zstd level of the compressed raw frames, -7 (fastest) to 19 (smallest).
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(ClampMin=-7, ClampMax=19, UIMin=-7, UIMax=19) )
+    int32 RawCompressionLevel;
+    // zstd worker threads per compressed raw frame, 0 compresses on the encoder worker itself.
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(ClampMin=0, UIMin=0) )
+    int32 RawCompressionWorkerCount;
+    // Frames the zstd dictionary of the compressed raw frames is trained on, 0 = no dictionary.
+    // Written as <Actor>.zdict once trained; the frames before it are compressed without one.
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(ClampMin=0, UIMin=0) )
+    int32 RawDictionaryFrameCount;
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(ClampMin=1, UIMin=1, Units="KB") )
+    int32 RawDictionarySizeKB;
+    // Extra layers written into the same exr as Z and N.X/N.Y/N.Z, captured from the same pose.
+    // NPY16 writes the depth into <Actor>_depth.npy instead.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="ImageFormat==ESCIImageFormat::EXR || ImageFormat==ESCIImageFormat::NPY16") )
+    bool IsExrWriteDepth;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="ImageFormat==ESCIImageFormat::EXR") )
+    bool IsExrWriteNormal;
+    // 8-bit sRGB preview next to every exr, tonemapped on the encoder workers from the same readback.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="ImageFormat==ESCIImageFormat::EXR") )
+    bool IsExrWritePreview;
+    // PNG, JPG or QOI.
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="IsExrWritePreview") )
+    ESCIImageFormat ExrPreviewFormat;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture", meta=(EditCondition="IsExrWritePreview", ClampMin=0.0) )
+    float ExrPreviewExposure;
+    UPROPERTY( EditAnywhere, Category="SCI|Compression" )
+    bool IsAdaptiveCompression;
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(EditCondition="IsAdaptiveCompression", ClampMin=0, ClampMax=9) )
+    int32 AdaptiveMinCompressionLevel;
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(EditCondition="IsAdaptiveCompression", ClampMin=0, ClampMax=9) )
+    int32 AdaptiveMaxCompressionLevel;
+    UPROPERTY( EditAnywhere, Category="SCI|Compression", meta=(EditCondition="IsAdaptiveCompression", ClampMin=0, Units="s") )
+    float AdaptiveCompressionInterval;
+    UPROPERTY( EditAnywhere, Category="SCI|Capture" )
     TWeakObjectPtr<class ACameraActor> CameraActor;
 
     UPROPERTY( VisibleAnywhere, Category="SCI|Capture" )
     TObjectPtr<class USceneCaptureComponent2D> SceneCaptureComponent;
+    UPROPERTY( Transient )
+    TObjectPtr<class USCISceneCaptureComponent> DepthCaptureComponent;
+    UPROPERTY( Transient )
+    TObjectPtr<class USCISceneCaptureComponent> NormalCaptureComponent;
+
+    UPROPERTY( VisibleAnywhere, Category="SCI|Stats" )
+    int32 ReadbackStallCount;
+    UPROPERTY( VisibleAnywhere, Category="SCI|Stats" )
+    int32 RenderRequestPoolHits;
+    UPROPERTY( VisibleAnywhere, Category="SCI|Stats" )
+    int32 RenderRequestPoolMisses;
+    UPROPERTY( VisibleAnywhere, Category="SCI|Stats" )
+    int32 RenderRequestQueueDepth;
+    UPROPERTY( VisibleAnywhere, Category="SCI|Stats" )
+    int32 QueuedWriteCount;
+    UPROPERTY( VisibleAnywhere, Category="SCI|Stats" )
+    int32 SubmitWouldBlockCount;
+    UPROPERTY( VisibleAnywhere, Category="SCI|Stats" )
+    int32 CurrentPngCompressionLevel;
+    // Raw over encoded size of everything encoded so far.
+    UPROPERTY( VisibleAnywhere, Category="SCI|Stats" )
+    float EncodeCompressionRatio;
+    // Raw megabytes per second of encoder worker time.
+    UPROPERTY( VisibleAnywhere, Category="SCI|Stats" )
+    float EncodeMegabytesPerSecond;
 
     UPROPERTY( EditAnywhere, Category="SCI|Settings" )
     bool EnableDefaultInputBindings;
@@ -99,10 +263,22 @@ private:
     UPROPERTY( EditAnywhere, Category="SCI|Settings|Keys" )
     FKey ResetLODKey;
 
-    TSharedPtr<class IImageWrapper> ImageWrapper;
-
     int32 ImageCounter;
+    TArray<FSCIOutputSink> ActiveOutputSinks;
+    float AdaptiveCompressionTimer;
+
+    FSCIReadbackRing ReadbackRing;
+    FSCIImageEncoderPool EncoderPool;
+    FSCIImageWriterPool WriterPool;
+    FSCIFrameArchiveWriter FrameArchive;
+    FSCITarShardWriter TarShards;
+    FSCINpyWriter NpyFile;
+    FSCINpyWriter DepthNpyFile;
+    FSCIRawDictionary RawDictionary;
+
+    TQueue<FSCIRenderRequest*> RenderRequestQueue;
+    TQueue<FSCIFloatRenderRequest*> ExrRenderRequestQueue;
 
-    TQueue<struct FSCIRenderRequest*> RenderRequestQueue;
-    TQueue<struct FSCIFloatRenderRequest*> ExrRenderRequestQueue;
+    TSCIRenderRequestPool<FSCIRenderRequest> RenderRequestPool;
+    TSCIRenderRequestPool<FSCIFloatRenderRequest> ExrRenderRequestPool;
 };
@@ -23,23 +23,29 @@ void USCISceneCaptureComponent::BeginPlay()
 void USCISceneCaptureComponent::SetupTextureTarget()
 {
     if ( ensure( OwnerSceneCapture.IsValid() ) ) {
-        auto imageFormat = OwnerSceneCapture->GetImageFormat();
-        auto resolution  = OwnerSceneCapture->GetRenderResolution();
-		auto pixelFormat = EPixelFormat::PF_Unknown;
+        // The encoder registered for the image format decides what the target holds.
+        auto captureFormat = SCI::GetCaptureFormat( OwnerSceneCapture->GetImageFormat() );
+        auto resolution    = OwnerSceneCapture->GetRenderResolution();
+        auto pixelFormat   = SCI::GetRenderTargetPixelFormat( captureFormat );
+        auto targetFormat  = SCI::GetRenderTargetFormat( captureFormat );
+        auto targetGamma   = captureFormat == ESCICaptureFormat::Float16 
+        ? GEngine->GetDisplayGamma() 
+        : 1.2f;
+
+        // Depth and normal layer components keep the source they were created with.
+        if ( (CaptureSource == ESceneCaptureSource::SCS_FinalColorLDR) || (CaptureSource == ESceneCaptureSource::SCS_FinalColorHDR) )
+            CaptureSource = SCI::GetCaptureSource( captureFormat );
+
+        // Depth is in centimeters and needs full floats, a half would overflow past 655 m.
+        if ( CaptureSource == ESceneCaptureSource::SCS_SceneDepth ) {
+            pixelFormat  = PF_R32_FLOAT;
+            targetFormat = ETextureRenderTargetFormat::RTF_R32f;
+        }
+
         if ( TextureTarget == nullptr ) {
             auto renderTarget = NewObject<UTextureRenderTarget2D>( this );
-
-            renderTarget->RenderTargetFormat = (imageFormat == ESCIImageFormat::EXR) 
-            ? ETextureRenderTargetFormat::RTF_RGBA16f 
-            : ETextureRenderTargetFormat::RTF_RGBA8;
-
-            auto pixelFormat = (imageFormat == ESCIImageFormat::EXR) 
-            ? PF_FloatRGBA 
-            : PF_B8G8R8A8;
-
-            renderTarget->TargetGamma = (imageFormat == ESCIImageFormat::EXR) 
-            ? GEngine->GetDisplayGamma() 
-            : 1.2f;
+            renderTarget->RenderTargetFormat = targetFormat;
+            renderTarget->TargetGamma        = targetGamma;
 		    
             // Demand buffer on GPU
             renderTarget->bGPUSharedFlag = true;
@@ -48,18 +54,9 @@ void USCISceneCaptureComponent::SetupTextureTarget()
             TextureTarget = renderTarget;
         }
         else {
-            TextureTarget->RenderTargetFormat = (imageFormat == ESCIImageFormat::EXR) 
-            ? ETextureRenderTargetFormat::RTF_RGBA16f 
-            : ETextureRenderTargetFormat::RTF_RGBA8;
-
-            TextureTarget->TargetGamma = (imageFormat == ESCIImageFormat::EXR) 
-            ? GEngine->GetDisplayGamma() 
-            : 1.2f;
-            TextureTarget->bForceLinearGamma = true;
-
-			pixelFormat = (imageFormat == ESCIImageFormat::EXR) 
-            ? PF_FloatRGBA 
-            : PF_B8G8R8A8;
+            TextureTarget->RenderTargetFormat = targetFormat;
+            TextureTarget->TargetGamma        = targetGamma;
+            TextureTarget->bForceLinearGamma  = true;
         }
 
 		TextureTarget->InitCustomFormat( resolution.X, resolution.Y, pixelFormat, false );
@@ -0,0 +1,296 @@
+#include "SCITarShardWriter.h"
+#include "../VLog.h"
+#include <Async/Async.h>
+#include <HAL/PlatformFileManager.h>
+#include <Misc/DateTime.h>
+#include <Misc/Paths.h>
+#include <Misc/ScopeLock.h>
+#include <Policies/CondensedJsonPrintPolicy.h>
+#include <Serialization/JsonWriter.h>
+
+namespace SCI
+{
+    // POSIX ustar member header, every field is ASCII.
+    struct FTarHeader
+    {
+        ANSICHAR Name[ 100 ];
+        ANSICHAR Mode[ 8 ];
+        ANSICHAR UserId[ 8 ];
+        ANSICHAR GroupId[ 8 ];
+        ANSICHAR Size[ 12 ];
+        ANSICHAR ModifiedTime[ 12 ];
+        ANSICHAR Checksum[ 8 ];
+        ANSICHAR TypeFlag;
+        ANSICHAR LinkName[ 100 ];
+        ANSICHAR Magic[ 6 ];
+        ANSICHAR Version[ 2 ];
+        ANSICHAR UserName[ 32 ];
+        ANSICHAR GroupName[ 32 ];
+        ANSICHAR DeviceMajor[ 8 ];
+        ANSICHAR DeviceMinor[ 8 ];
+        ANSICHAR Prefix[ 155 ];
+        ANSICHAR Padding[ 12 ];
+    };
+    static_assert( sizeof( FTarHeader ) == FSCITarShardWriter::BLOCK_SIZE, "A tar header fills one block." );
+
+    const uint8 TAR_ZERO_BLOCKS[ FSCITarShardWriter::BLOCK_SIZE * 2 ] = {};
+
+    // Zero padded octal, NUL terminated.
+    void WriteTarOctal( ANSICHAR* OutField, int32 InFieldSize, uint64 InValue )
+    {
+        OutField[ InFieldSize - 1 ] = '\0';
+        for ( int32 i = InFieldSize - 2; i >= 0; i-- ) {
+            OutField[ i ] = (ANSICHAR)('0' + (InValue & 7));
+            InValue >>= 3;
+        }
+    }
+
+    // Names longer than 100 bytes are split at a slash into the 155 byte prefix and the name.
+    bool SetTarMemberName( const FTCHARToUTF8& InName, FTarHeader& OutHeader )
+    {
+        const auto name   = InName.Get();
+        const auto length = InName.Length();
+        if ( length <= (int32)sizeof( OutHeader.Name ) ) {
+            FMemory::Memcpy( OutHeader.Name, name, length );
+            return true;
+        }
+
+        for ( int32 i = FMath::Min( length - 1, (int32)sizeof( OutHeader.Prefix ) ); (i > 0) && (length - i - 1 <= (int32)sizeof( OutHeader.Name )); i-- ) {
+            if ( name[ i ] == '/' ) {
+                FMemory::Memcpy( OutHeader.Prefix, name, i );
+                FMemory::Memcpy( OutHeader.Name, name + i + 1, length - i - 1 );
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool MakeTarHeader( const FString& InName, int64 InSize, int64 InModifiedTime, FTarHeader& OutHeader )
+    {
+        FMemory::Memzero( OutHeader );
+        if ( !SetTarMemberName( FTCHARToUTF8( *InName ), OutHeader ) || (InSize >= (1ll << 33)) )
+            return false;
+
+        WriteTarOctal( OutHeader.Mode, sizeof( OutHeader.Mode ), 0644 );
+        WriteTarOctal( OutHeader.UserId, sizeof( OutHeader.UserId ), 0 );
+        WriteTarOctal( OutHeader.GroupId, sizeof( OutHeader.GroupId ), 0 );
+        WriteTarOctal( OutHeader.Size, sizeof( OutHeader.Size ), InSize );
+        WriteTarOctal( OutHeader.ModifiedTime, sizeof( OutHeader.ModifiedTime ), InModifiedTime );
+        OutHeader.TypeFlag = '0';
+        FMemory::Memcpy( OutHeader.Magic, "ustar", 6 );
+        FMemory::Memcpy( OutHeader.Version, "00", 2 );
+
+        // Summed with the checksum field itself taken as spaces.
+        FMemory::Memset( OutHeader.Checksum, ' ', sizeof( OutHeader.Checksum ) );
+        uint32 checksum = 0;
+        for ( auto byte : TArrayView<const uint8>( reinterpret_cast<const uint8*>( &OutHeader ), sizeof( OutHeader ) ) )
+            checksum += byte;
+        WriteTarOctal( OutHeader.Checksum, 7, checksum );
+        return true;
+    }
+
+    FString MakeTarSampleMetadata( int64 InFrameId, const FString& InName, int64 InSize, const FString& InSource, const FDateTime& InTime )
+    {
+        // One condensed object per line, the writer escapes the names.
+        FString metadata;
+        auto writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create( &metadata );
+        writer->WriteObjectStart();
+        writer->WriteValue( TEXT( "frame" ), InFrameId );
+        writer->WriteValue( TEXT( "file" ), InName );
+        writer->WriteValue( TEXT( "size" ), InSize );
+        writer->WriteValue( TEXT( "source" ), InSource );
+        writer->WriteValue( TEXT( "time" ), InTime.ToIso8601() );
+        writer->WriteObjectEnd();
+        writer->Close();
+
+        metadata += TEXT( "\n" );
+        return metadata;
+    }
+
+    // Runs on its own thread, so capture goes on writing the next shard meanwhile.
+    void FinalizeTarShard( TUniquePtr<IFileHandle>&& InFile, const FString& InPartFilename, const FString& InFilename )
+    {
+        // Two zero blocks end the archive.
+        const auto isWritten = InFile->Write( TAR_ZERO_BLOCKS, sizeof( TAR_ZERO_BLOCKS ) ) && InFile->Flush();
+        InFile.Reset();
+
+        // The final name only appears once the shard is complete, so readers can pick it up right away.
+        auto& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+        platformFile.DeleteFile( *InFilename );
+        if ( !isWritten || !platformFile.MoveFile( *InFilename, *InPartFilename ) )
+            VLOG( Error, TEXT( "Failed to finalize tar shard: %s" ), *InFilename );
+        else
+            VLOG( Log, TEXT( "Tar shard finalized: %s" ), *InFilename );
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+FSCITarShardWriter::FSCITarShardWriter()
+{
+    IsOpened    = false;
+    ShardSize   = 0;
+    ShardIndex  = INDEX_NONE;
+    ShardOffset = 0;
+    SampleCount = 0;
+}
+
+FSCITarShardWriter::~FSCITarShardWriter()
+{
+    Close();
+}
+
+FString FSCITarShardWriter::GetShardFilename( const FString& InBaseFilename, int32 InShard )
+{
+    // WebDataset brace notation: <Base>-{000000..000042}.tar
+    return FString::Printf( TEXT( "%s-%06d.tar" ), *InBaseFilename, InShard );
+}
+
+bool FSCITarShardWriter::Open( const FString& InBaseFilename, const FString& InRootDirectory, int64 InShardSize )
+{
+    Close();
+
+    if ( !FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree( *FPaths::GetPath( InBaseFilename ) ) ) {
+        VLOG( Error, TEXT( "Failed to create tar shard directory: %s" ), *InBaseFilename );
+        return false;
+    }
+
+    FScopeLock lock( &Mutex );
+    IsOpened      = true;
+    BaseFilename  = InBaseFilename;
+    RootDirectory = InRootDirectory;
+    SourceName    = FPaths::GetCleanFilename( InBaseFilename );
+    ShardSize     = Align( FMath::Max( InShardSize, BLOCK_SIZE * 2 ), BLOCK_SIZE );
+    ShardIndex    = INDEX_NONE;
+    ShardOffset   = 0;
+    SampleCount   = 0;
+
+    VLOG( Display, TEXT( "Tar shards opened: %s (Shard: %lld MB)" ), *BaseFilename, ShardSize >> 20 );
+    return true;
+}
+
+void FSCITarShardWriter::Close()
+{
+    TArray<TFuture<void>> closingShards;
+    {
+        FScopeLock lock( &Mutex );
+        if ( !IsOpened )
+            return;
+
+        CloseShard();
+        closingShards = MoveTemp( ClosingShards );
+        IsOpened = false;
+    }
+
+    for ( auto& closingShard : closingShards )
+        closingShard.Wait();
+
+    VLOG( Display, TEXT( "Tar shards closed: %s (Samples: %d in %d shards)" ), *BaseFilename, SampleCount, ShardIndex + 1 );
+}
+
+bool FSCITarShardWriter::IsOpen() const
+{
+    FScopeLock lock( &Mutex );
+    return IsOpened;
+}
+
+bool FSCITarShardWriter::Append( int64 InFrameId, const FString& InName, const TArray64<uint8>& InData )
+{
+    // Open() replaces the root directory and the source name under the lock, so they are copied under it too.
+    FString rootDirectory;
+    FString sourceName;
+    {
+        FScopeLock lock( &Mutex );
+        rootDirectory = RootDirectory;
+        sourceName    = SourceName;
+    }
+
+    auto name = InName;
+    FPaths::MakePathRelativeTo( name, *rootDirectory );
+
+    const auto cleanName = FPaths::GetCleanFilename( name );
+    int32 extensionIndex = INDEX_NONE;
+    cleanName.FindChar( TEXT( '.' ), extensionIndex );
+    const auto key = extensionIndex != INDEX_NONE ? name.LeftChop( cleanName.Len() - extensionIndex ) : name;
+
+    const auto time     = FDateTime::UtcNow();
+    const FTCHARToUTF8 metadata( *SCI::MakeTarSampleMetadata( InFrameId, name, InData.Num(), sourceName, time ) );
+
+    SCI::FTarHeader imageHeader;
+    SCI::FTarHeader metadataHeader;
+    if ( !SCI::MakeTarHeader( name, InData.Num(), time.ToUnixTimestamp(), imageHeader )
+    || !SCI::MakeTarHeader( key + TEXT( ".json" ), metadata.Length(), time.ToUnixTimestamp(), metadataHeader ) ) {
+        VLOG( Error, TEXT( "Image does not fit into a tar member: %s" ), *name );
+        return false;
+    }
+
+    const auto imagePadding    = Align( InData.Num(), BLOCK_SIZE ) - InData.Num();
+    const auto metadataPadding = Align( (int64)metadata.Length(), BLOCK_SIZE ) - metadata.Length();
+    const auto sampleSize      = BLOCK_SIZE * 2 + InData.Num() + imagePadding + metadata.Length() + metadataPadding;
+
+    // One sequential stream per shard, the image and its metadata always land next to each other.
+    FScopeLock lock( &Mutex );
+    if ( !IsOpened )
+        return false;
+
+    // A sample larger than a shard gets one of its own.
+    if ( !Shard.IsValid() || ((ShardOffset > 0) && (ShardOffset + sampleSize > ShardSize)) ) {
+        if ( !OpenShard() )
+            return false;
+    }
+
+    const auto isWritten = Shard->Write( reinterpret_cast<const uint8*>( &imageHeader ), sizeof( imageHeader ) )
+    && Shard->Write( InData.GetData(), InData.Num() )
+    && Shard->Write( SCI::TAR_ZERO_BLOCKS, imagePadding )
+    && Shard->Write( reinterpret_cast<const uint8*>( &metadataHeader ), sizeof( metadataHeader ) )
+    && Shard->Write( reinterpret_cast<const uint8*>( metadata.Get() ), metadata.Length() )
+    && Shard->Write( SCI::TAR_ZERO_BLOCKS, metadataPadding );
+    if ( !isWritten ) {
+        VLOG( Error, TEXT( "Failed to append to tar shard: %s" ), *name );
+        return false;
+    }
+
+    ShardOffset += sampleSize;
+    SampleCount++;
+    return true;
+}
+
+int32 FSCITarShardWriter::GetShardCount() const
+{
+    FScopeLock lock( &Mutex );
+    return ShardIndex + 1;
+}
+
+int32 FSCITarShardWriter::GetSampleCount() const
+{
+    FScopeLock lock( &Mutex );
+    return SampleCount;
+}
+
+bool FSCITarShardWriter::OpenShard()
+{
+    CloseShard();
+
+    ShardIndex++;
+    const auto filename = GetShardFilename( BaseFilename, ShardIndex ) + TEXT( ".part" );
+    Shard.Reset( FPlatformFileManager::Get().GetPlatformFile().OpenWrite( *filename ) );
+    if ( !Shard.IsValid() ) {
+        VLOG( Error, TEXT( "Failed to create tar shard: %s" ), *filename );
+        return false;
+    }
+
+    ShardOffset = 0;
+    return true;
+}
+
+void FSCITarShardWriter::CloseShard()
+{
+    ClosingShards.RemoveAll( []( const TFuture<void>& InClosingShard ){ return InClosingShard.IsReady(); } );
+    if ( !Shard.IsValid() )
+        return;
+
+    const auto filename = GetShardFilename( BaseFilename, ShardIndex );
+    ClosingShards.Add( Async( EAsyncExecution::Thread, [shard = MoveTemp( Shard ), filename]() mutable {
+        SCI::FinalizeTarShard( MoveTemp( shard ), filename + TEXT( ".part" ), filename );
+    }));
+}
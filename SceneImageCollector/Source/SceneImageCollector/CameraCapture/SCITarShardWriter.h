@@ -0,0 +1,55 @@
+// Copyright Devcoder.
+#pragma once
+#include "SCIAsyncSaveImageTask.h"
+#include <CoreMinimal.h>
+#include <Async/Future.h>
+
+class IFileHandle;
+
+// Streams encoded images into rolling WebDataset shards, plain ustar files a trainer reads
+// front to back without unpacking:
+//
+//   <Base>-<NNNNNN>.tar    written as <Base>-<NNNNNN>.tar.part until the shard is complete
+//
+// Every image is stored under its path relative to the root and followed by <Key>.json with
+// the frame metadata, where the key is the path up to the first dot of the file name. That is
+// how WebDataset groups members into samples, and a sample never spans two shards.
+class FSCITarShardWriter : public ISCIFrameContainer
+{
+public:
+    static constexpr int64 BLOCK_SIZE = 512;
+
+    FSCITarShardWriter();
+    virtual ~FSCITarShardWriter();
+
+    static FString GetShardFilename( const FString& InBaseFilename, int32 InShard );
+
+    // Names are stored relative to InRootDirectory, the base name goes into the metadata as the source.
+    bool Open( const FString& InBaseFilename, const FString& InRootDirectory, int64 InShardSize );
+    // Waits for every shard to be finalized.
+    void Close();
+    bool IsOpen() const;
+
+    virtual bool Append( int64 InFrameId, const FString& InName, const TArray64<uint8>& InData ) override;
+
+    int32 GetShardCount() const;
+    int32 GetSampleCount() const;
+
+private:
+    bool OpenShard();
+    void CloseShard();
+
+private:
+    mutable FCriticalSection Mutex;
+    bool IsOpened;
+    FString BaseFilename;
+    FString RootDirectory;
+    FString SourceName;
+    int64 ShardSize;
+    int32 ShardIndex;
+    int64 ShardOffset;
+    TUniquePtr<IFileHandle> Shard;
+    // Shards being finalized in the background.
+    TArray<TFuture<void>> ClosingShards;
+    int32 SampleCount;
+};
@@ -0,0 +1,545 @@
+#include "SCIUringFileWriter.h"
+#include "../VLog.h"
+#include <HAL/PlatformFileManager.h>
+#include <HAL/RunnableThread.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+
+#if PLATFORM_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace SCI
+{
+#if PLATFORM_LINUX
+    // The engine sysroot predates io_uring, so the little of the kernel ABI used here is spelled out.
+    // The system call numbers are the same on every 64-bit architecture.
+    constexpr long URING_SYSCALL_SETUP      = 425;
+    constexpr long URING_SYSCALL_ENTER      = 426;
+    constexpr uint64 URING_OFF_SQ_RING      = 0;
+    constexpr uint64 URING_OFF_CQ_RING      = 0x8000000;
+    constexpr uint64 URING_OFF_SQES         = 0x10000000;
+    constexpr uint32 URING_FEAT_SINGLE_MMAP = 1 << 0;
+    constexpr uint32 URING_ENTER_GETEVENTS  = 1 << 0;
+    constexpr uint8 URING_OP_WRITEV         = 2;
+
+    // Below the kernel's per-call limit, and a multiple of the O_DIRECT alignment.
+    constexpr int64 URING_MAX_WRITE_SIZE   = 1ll << 30;
+    constexpr int64 URING_DIRECT_ALIGNMENT = 4096;
+
+    struct FUringSqe
+    {
+        uint8 Opcode;
+        uint8 Flags;
+        uint16 IoPriority;
+        int32 File;
+        uint64 Offset;
+        uint64 Address;
+        uint32 Length;
+        uint32 OpFlags;
+        uint64 UserData;
+        uint64 Reserved[ 3 ];
+    };
+    static_assert( sizeof( FUringSqe ) == 64, "io_uring_sqe layout." );
+
+    struct FUringCqe
+    {
+        uint64 UserData;
+        int32 Result;
+        uint32 Flags;
+    };
+    static_assert( sizeof( FUringCqe ) == 16, "io_uring_cqe layout." );
+
+    struct FUringSqOffsets
+    {
+        uint32 Head;
+        uint32 Tail;
+        uint32 RingMask;
+        uint32 RingEntries;
+        uint32 Flags;
+        uint32 Dropped;
+        uint32 Array;
+        uint32 Reserved1;
+        uint64 Reserved2;
+    };
+
+    struct FUringCqOffsets
+    {
+        uint32 Head;
+        uint32 Tail;
+        uint32 RingMask;
+        uint32 RingEntries;
+        uint32 Overflow;
+        uint32 Cqes;
+        uint32 Flags;
+        uint32 Reserved1;
+        uint64 Reserved2;
+    };
+
+    struct FUringParams
+    {
+        uint32 SqEntries;
+        uint32 CqEntries;
+        uint32 Flags;
+        uint32 SqThreadCpu;
+        uint32 SqThreadIdle;
+        uint32 Features;
+        uint32 WqFd;
+        uint32 Reserved[ 3 ];
+        FUringSqOffsets SqOffsets;
+        FUringCqOffsets CqOffsets;
+    };
+    static_assert( sizeof( FUringParams ) == 120, "io_uring_params layout." );
+
+    // One submission and one completion ring, only ever touched by the I/O thread.
+    class FUring
+    {
+    public:
+        FUring() = default;
+        ~FUring()
+        {
+            Release();
+        }
+
+        // Negative errno when the kernel has no io_uring or does not allow it.
+        int32 Initialize( uint32 InEntryCount )
+        {
+            FUringParams params;
+            FMemory::Memzero( params );
+            File = (int32)syscall( URING_SYSCALL_SETUP, InEntryCount, &params );
+            if ( File < 0 )
+                return -errno;
+
+            SqRingSize = params.SqOffsets.Array + params.SqEntries * sizeof( uint32 );
+            CqRingSize = params.CqOffsets.Cqes + params.CqEntries * sizeof( FUringCqe );
+            SqesSize   = params.SqEntries * sizeof( FUringSqe );
+            const auto isSingleMap = (params.Features & URING_FEAT_SINGLE_MMAP) != 0;
+            if ( isSingleMap )
+                SqRingSize = CqRingSize = FMath::Max( SqRingSize, CqRingSize );
+
+            SqRing = Map( SqRingSize, URING_OFF_SQ_RING );
+            CqRing = isSingleMap ? SqRing : Map( CqRingSize, URING_OFF_CQ_RING );
+            Sqes   = static_cast<FUringSqe*>( Map( SqesSize, URING_OFF_SQES ) );
+            if ( (SqRing == nullptr) || (CqRing == nullptr) || (Sqes == nullptr) ) {
+                const auto error = -errno;
+                Release();
+                return error;
+            }
+
+            const auto sq = static_cast<uint8*>( SqRing );
+            SqHead        = reinterpret_cast<uint32*>( sq + params.SqOffsets.Head );
+            SqTail        = reinterpret_cast<uint32*>( sq + params.SqOffsets.Tail );
+            SqArray       = reinterpret_cast<uint32*>( sq + params.SqOffsets.Array );
+            SqMask        = *reinterpret_cast<uint32*>( sq + params.SqOffsets.RingMask );
+            SqEntryCount  = params.SqEntries;
+            SqLocalTail   = *SqTail;
+            SubmittedTail = SqLocalTail;
+
+            const auto cq = static_cast<uint8*>( CqRing );
+            CqHead = reinterpret_cast<uint32*>( cq + params.CqOffsets.Head );
+            CqTail = reinterpret_cast<uint32*>( cq + params.CqOffsets.Tail );
+            CqMask = *reinterpret_cast<uint32*>( cq + params.CqOffsets.RingMask );
+            Cqes   = reinterpret_cast<FUringCqe*>( cq + params.CqOffsets.Cqes );
+            return 0;
+        }
+
+        void Release()
+        {
+            if ( Sqes != nullptr )
+                munmap( Sqes, SqesSize );
+            if ( (CqRing != nullptr) && (CqRing != SqRing) )
+                munmap( CqRing, CqRingSize );
+            if ( SqRing != nullptr )
+                munmap( SqRing, SqRingSize );
+            if ( File >= 0 )
+                close( File );
+
+            Sqes   = nullptr;
+            CqRing = nullptr;
+            SqRing = nullptr;
+            File   = -1;
+        }
+
+        // nullptr while every entry waits for the next Submit.
+        FUringSqe* GetSqe()
+        {
+            const auto head = __atomic_load_n( SqHead, __ATOMIC_ACQUIRE );
+            if ( SqLocalTail - head >= SqEntryCount )
+                return nullptr;
+
+            const auto index = SqLocalTail & SqMask;
+            auto sqe = &Sqes[ index ];
+            FMemory::Memzero( *sqe );
+            SqArray[ index ] = index;
+            SqLocalTail++;
+            return sqe;
+        }
+
+        // Hands every new entry to the kernel in one call, negative errno on failure.
+        int32 Submit( uint32 InWaitCount )
+        {
+            __atomic_store_n( SqTail, SqLocalTail, __ATOMIC_RELEASE );
+            while ( true ) {
+                const auto result = (int32)syscall( URING_SYSCALL_ENTER, File, SqLocalTail - SubmittedTail, InWaitCount
+                , InWaitCount > 0 ? URING_ENTER_GETEVENTS : 0, nullptr, 0 );
+                if ( result >= 0 ) {
+                    SubmittedTail += result;
+                    return result;
+                }
+                if ( errno != EINTR )
+                    return -errno;
+            }
+        }
+
+        template<typename FunctionType>
+        void ReapCompletions( FunctionType&& InFunction )
+        {
+            auto head = *CqHead;
+            const auto tail = __atomic_load_n( CqTail, __ATOMIC_ACQUIRE );
+            for ( ; head != tail; head++ ) {
+                const auto& cqe = Cqes[ head & CqMask ];
+                InFunction( cqe.UserData, cqe.Result );
+            }
+            __atomic_store_n( CqHead, head, __ATOMIC_RELEASE );
+        }
+
+    private:
+        void* Map( int64 InSize, uint64 InOffset )
+        {
+            const auto data = mmap( nullptr, InSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, File, InOffset );
+            return data != MAP_FAILED ? data : nullptr;
+        }
+
+    private:
+        int32 File = -1;
+        void* SqRing = nullptr;
+        void* CqRing = nullptr;
+        FUringSqe* Sqes = nullptr;
+        int64 SqRingSize = 0;
+        int64 CqRingSize = 0;
+        int64 SqesSize = 0;
+        uint32* SqHead = nullptr;
+        uint32* SqTail = nullptr;
+        uint32* SqArray = nullptr;
+        uint32 SqMask = 0;
+        uint32 SqEntryCount = 0;
+        uint32 SqLocalTail = 0;
+        uint32 SubmittedTail = 0;
+        uint32* CqHead = nullptr;
+        uint32* CqTail = nullptr;
+        uint32 CqMask = 0;
+        FUringCqe* Cqes = nullptr;
+    };
+
+    int32 OpenUringFile( const FString& InFilename, bool InIsDirect )
+    {
+        const auto filename = FPaths::ConvertRelativePathToFull( InFilename );
+        const auto flags    = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (InIsDirect ? O_DIRECT : 0);
+        auto file = open( TCHAR_TO_UTF8( *filename ), flags, 0644 );
+        if ( (file < 0) && (errno == ENOENT) ) {
+            // Missing directories are created, the same as FFileHelper does.
+            FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree( *FPaths::GetPath( filename ) );
+            file = open( TCHAR_TO_UTF8( *filename ), flags, 0644 );
+        }
+        return file;
+    }
+#else
+    class FUring
+    {
+    };
+#endif
+}
+
+//-----------------------------------------------------------------------------
+
+struct FSCIUringFileWriter::FWrite
+{
+    FRequest* Request = nullptr;
+    int64 Offset = 0;
+    const uint8* Data = nullptr;
+    int64 Size = 0;
+#if PLATFORM_LINUX
+    iovec Vector;
+#endif
+};
+
+struct FSCIUringFileWriter::FRequest
+{
+    ~FRequest()
+    {
+        if ( AlignedData != nullptr )
+            FMemory::Free( AlignedData );
+    }
+
+    FString Filename;
+    TArray64<uint8> Data;
+    TUniqueFunction<void( bool )> OnFinished;
+    int32 File = -1;
+    // O_DIRECT copy padded to whole blocks, the padding is cut off after the last write.
+    uint8* AlignedData = nullptr;
+    TArray<FWrite> Writes;
+    int32 PendingWriteCount = 0;
+    bool IsFailed = false;
+};
+
+//-----------------------------------------------------------------------------
+
+FSCIUringFileWriter::FSCIUringFileWriter()
+{
+    Thread     = nullptr;
+    WakeEvent  = nullptr;
+    IsStopping = false;
+}
+
+FSCIUringFileWriter::~FSCIUringFileWriter()
+{
+    Release();
+}
+
+bool FSCIUringFileWriter::Initialize( const FOptions& InOptions )
+{
+    Release();
+
+#if PLATFORM_LINUX
+    Options = InOptions;
+    Options.QueueDepth = FMath::Clamp( InOptions.QueueDepth, 1, 4096 );
+
+    // Room for two writes per file, so a full queue never waits for submission entries.
+    Ring = MakeUnique<SCI::FUring>();
+    const auto result = Ring->Initialize( FMath::RoundUpToPowerOfTwo( (uint32)Options.QueueDepth * 2 ) );
+    if ( result < 0 ) {
+        VLOG( Warning, TEXT( "io_uring is not available (errno %d), files are written synchronously." ), -result );
+        Ring.Reset();
+        return false;
+    }
+
+    IsStopping = false;
+    WakeEvent  = FPlatformProcess::GetSynchEventFromPool( false );
+    Thread     = FRunnableThread::Create( this, TEXT( "SCIUringFileWriter" ), 128 * 1024, TPri_BelowNormal );
+    if ( Thread == nullptr ) {
+        FPlatformProcess::ReturnSynchEventToPool( WakeEvent );
+        WakeEvent = nullptr;
+        Ring.Reset();
+        return false;
+    }
+
+    VLOG( Display, TEXT( "io_uring file writer started (Queue depth: %d, O_DIRECT: %s)" )
+    , Options.QueueDepth, Options.IsDirectIO ? TEXT( "On" ) : TEXT( "Off" ) );
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FSCIUringFileWriter::Release()
+{
+    if ( Thread == nullptr )
+        return;
+
+    // The thread drains the queue before it returns.
+    Stop();
+    Thread->WaitForCompletion();
+    delete Thread;
+    Thread = nullptr;
+
+    FPlatformProcess::ReturnSynchEventToPool( WakeEvent );
+    WakeEvent = nullptr;
+    Ring.Reset();
+}
+
+bool FSCIUringFileWriter::IsAvailable() const
+{
+    return Thread != nullptr;
+}
+
+int32 FSCIUringFileWriter::GetQueueDepth() const
+{
+    return Options.QueueDepth;
+}
+
+void FSCIUringFileWriter::Write( TArray64<uint8>&& InData, const FString& InFilename, TUniqueFunction<void( bool )>&& InOnFinished )
+{
+    check( IsAvailable() );
+
+    auto request = new FRequest;
+    request->Filename   = InFilename;
+    request->Data       = MoveTemp( InData );
+    request->OnFinished = MoveTemp( InOnFinished );
+    PendingRequests.Enqueue( request );
+    WakeEvent->Trigger();
+}
+
+uint32 FSCIUringFileWriter::Run()
+{
+#if PLATFORM_LINUX
+    int32 inFlightCount = 0;
+    while ( true ) {
+        // Everything queued since the last wake-up goes out with one submission.
+        FRequest* request = nullptr;
+        while ( (inFlightCount < Options.QueueDepth) && PendingRequests.Dequeue( request ) ) {
+            if ( StartRequest( request ) )
+                inFlightCount++;
+        }
+
+        if ( inFlightCount == 0 ) {
+            if ( IsStopping.Load() && PendingRequests.IsEmpty() )
+                break;
+
+            WakeEvent->Wait();
+            continue;
+        }
+
+        // Only block on the disk when no new file could be started anyway.
+        const auto waitCount = ((inFlightCount >= Options.QueueDepth) || PendingRequests.IsEmpty()) ? 1 : 0;
+        const auto result    = Ring->Submit( waitCount );
+        if ( (result < 0) && (result != -EAGAIN) && (result != -EBUSY) ) {
+            VLOG( Error, TEXT( "io_uring submission failed (errno %d)." ), -result );
+            FPlatformProcess::Sleep( 0.001f );
+        }
+
+        inFlightCount -= ReapCompletions();
+    }
+#endif
+    return 0;
+}
+
+void FSCIUringFileWriter::Stop()
+{
+    IsStopping = true;
+    if ( WakeEvent != nullptr )
+        WakeEvent->Trigger();
+}
+
+bool FSCIUringFileWriter::StartRequest( FRequest* InRequest )
+{
+#if PLATFORM_LINUX
+    // Not every file system takes O_DIRECT, those files are written buffered.
+    const auto size = InRequest->Data.Num();
+    auto isDirect   = Options.IsDirectIO && (size >= Options.DirectWriteSize);
+    auto file       = SCI::OpenUringFile( InRequest->Filename, isDirect );
+    if ( (file < 0) && isDirect ) {
+        isDirect = false;
+        file     = SCI::OpenUringFile( InRequest->Filename, false );
+    }
+
+    if ( file < 0 ) {
+        InRequest->IsFailed = true;
+        FinishRequest( InRequest );
+        return false;
+    }
+    InRequest->File = file;
+
+    auto data      = InRequest->Data.GetData();
+    auto writeSize = size;
+    if ( isDirect ) {
+        writeSize = Align( size, SCI::URING_DIRECT_ALIGNMENT );
+        InRequest->AlignedData = static_cast<uint8*>( FMemory::Malloc( writeSize, SCI::URING_DIRECT_ALIGNMENT ) );
+        FMemory::Memcpy( InRequest->AlignedData, data, size );
+        FMemory::Memzero( InRequest->AlignedData + size, writeSize - size );
+        data = InRequest->AlignedData;
+    }
+
+    const auto writeCount = (int32)((writeSize + SCI::URING_MAX_WRITE_SIZE - 1) / SCI::URING_MAX_WRITE_SIZE);
+    if ( writeCount == 0 ) {
+        FinishRequest( InRequest );
+        return false;
+    }
+
+    InRequest->Writes.SetNum( writeCount );
+    InRequest->PendingWriteCount = writeCount;
+    for ( int32 i = 0; i < writeCount; i++ ) {
+        auto& write = InRequest->Writes[ i ];
+        write.Request = InRequest;
+        write.Offset  = i * SCI::URING_MAX_WRITE_SIZE;
+        write.Data    = data + write.Offset;
+        write.Size    = FMath::Min( SCI::URING_MAX_WRITE_SIZE, writeSize - write.Offset );
+        QueueWrite( &write );
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FSCIUringFileWriter::QueueWrite( FWrite* InWrite )
+{
+#if PLATFORM_LINUX
+    auto sqe = Ring->GetSqe();
+    while ( sqe == nullptr ) {
+        // Only files larger than a write fill the ring, make room by submitting what is there.
+        Ring->Submit( 0 );
+        sqe = Ring->GetSqe();
+    }
+
+    InWrite->Vector.iov_base = const_cast<uint8*>( InWrite->Data );
+    InWrite->Vector.iov_len  = InWrite->Size;
+
+    sqe->Opcode   = SCI::URING_OP_WRITEV;
+    sqe->File     = InWrite->Request->File;
+    sqe->Offset   = InWrite->Offset;
+    sqe->Address  = reinterpret_cast<uint64>( &InWrite->Vector );
+    sqe->Length   = 1;
+    sqe->UserData = reinterpret_cast<uint64>( InWrite );
+#endif
+}
+
+int32 FSCIUringFileWriter::ReapCompletions()
+{
+    int32 finishedCount = 0;
+#if PLATFORM_LINUX
+    Ring->ReapCompletions( [&]( uint64 InUserData, int32 InResult ){
+        auto write   = reinterpret_cast<FWrite*>( InUserData );
+        auto request = write->Request;
+        if ( (InResult > 0) && (InResult < write->Size) ) {
+            // Short write, the rest goes out again.
+            write->Offset += InResult;
+            write->Data   += InResult;
+            write->Size   -= InResult;
+            QueueWrite( write );
+            return;
+        }
+
+        if ( InResult <= 0 ) {
+            VLOG( Warning, TEXT( "io_uring write failed (errno %d): %s" ), -InResult, *request->Filename );
+            request->IsFailed = true;
+        }
+
+        if ( --request->PendingWriteCount == 0 ) {
+            FinishRequest( request );
+            finishedCount++;
+        }
+    });
+#endif
+    return finishedCount;
+}
+
+void FSCIUringFileWriter::FinishRequest( FRequest* InRequest )
+{
+#if PLATFORM_LINUX
+    if ( InRequest->File >= 0 ) {
+        if ( (InRequest->AlignedData != nullptr) && !InRequest->IsFailed && (ftruncate( InRequest->File, InRequest->Data.Num() ) != 0) )
+            InRequest->IsFailed = true;
+        if ( close( InRequest->File ) != 0 )
+            InRequest->IsFailed = true;
+    }
+#endif
+
+    auto isWritten = !InRequest->IsFailed;
+    if ( isWritten ) {
+        VLOG( Log, TEXT( "Stored Image: %s" ), *InRequest->Filename );
+    }
+    else {
+        // Whatever went wrong, the file is still written the synchronous way.
+        VLOG( Warning, TEXT( "io_uring could not write %s, falling back to a synchronous write." ), *InRequest->Filename );
+        isWritten = FFileHelper::SaveArrayToFile( InRequest->Data, *InRequest->Filename );
+    }
+
+    if ( InRequest->OnFinished )
+        InRequest->OnFinished( isWritten );
+    delete InRequest;
+}
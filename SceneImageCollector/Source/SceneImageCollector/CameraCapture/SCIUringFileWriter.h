@@ -0,0 +1,64 @@
+// Copyright Devcoder.
+#pragma once
+#include <CoreMinimal.h>
+#include <Containers/Queue.h>
+#include <HAL/Runnable.h>
+
+class FRunnableThread;
+
+namespace SCI
+{
+    class FUring;
+}
+
+// Write-behind file writer on Linux io_uring. Callers hand over whole files; one I/O thread
+// opens them, keeps up to QueueDepth files in flight and submits everything queued since its
+// last wake-up with a single system call. Files of at least DirectWriteSize bytes can go
+// through O_DIRECT from 4 KB aligned copies, bypassing the page cache.
+//
+// Not available on other platforms or when the kernel refuses io_uring, the caller then keeps
+// writing with FFileHelper. A file that fails here is written with FFileHelper as well.
+class FSCIUringFileWriter : public FRunnable
+{
+public:
+    struct FOptions
+    {
+        int32 QueueDepth = 64;
+        bool IsDirectIO = false;
+        // Smaller files stay buffered, their aligned copy would cost more than the page cache.
+        int64 DirectWriteSize = 1024 * 1024;
+    };
+
+    FSCIUringFileWriter();
+    virtual ~FSCIUringFileWriter();
+
+    bool Initialize( const FOptions& InOptions );
+    // Finishes every queued file first.
+    void Release();
+    bool IsAvailable() const;
+    int32 GetQueueDepth() const;
+
+    // Thread safe. InOnFinished runs on the I/O thread once the file is closed.
+    void Write( TArray64<uint8>&& InData, const FString& InFilename, TUniqueFunction<void( bool )>&& InOnFinished );
+
+    // FRunnable
+    virtual uint32 Run() override;
+    virtual void Stop() override;
+
+private:
+    struct FRequest;
+    struct FWrite;
+
+    bool StartRequest( FRequest* InRequest );
+    void QueueWrite( FWrite* InWrite );
+    int32 ReapCompletions();
+    void FinishRequest( FRequest* InRequest );
+
+private:
+    FOptions Options;
+    TUniquePtr<SCI::FUring> Ring;
+    FRunnableThread* Thread;
+    FEvent* WakeEvent;
+    TAtomic<bool> IsStopping;
+    TQueue<FRequest*, EQueueMode::Mpsc> PendingRequests;
+};
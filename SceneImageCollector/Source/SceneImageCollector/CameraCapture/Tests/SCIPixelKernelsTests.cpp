@@ -0,0 +1,322 @@
+#include "../SCIPixelKernels.h"
+#include <Misc/AutomationTest.h>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace SCI
+{
+    // The vector paths step 2 to 16 pixels at a time, these counts leave every kind of scalar tail.
+    const int32 KERNEL_TEST_COUNTS[] = { 1, 3, 7, 13, 37, 301 };
+
+    constexpr uint8 KERNEL_TEST_GUARD = 0xCD;
+
+    // Compares the output and checks that nothing was written into the guard bytes after it.
+    bool TestKernelBytes( FAutomationTestBase& InTest, const TCHAR* InName, int32 InCount, const TArray<uint8>& InActual, const TArray<uint8>& InExpected )
+    {
+        for ( int32 i = 0; i < InActual.Num(); i++ ) {
+            const auto expected = i < InExpected.Num() ? InExpected[ i ] : KERNEL_TEST_GUARD;
+            if ( InActual[ i ] != expected ) {
+                InTest.AddError( FString::Printf( TEXT( "%s (%d pixels): byte %d is 0x%02X, expected 0x%02X" ), InName, InCount, i, InActual[ i ], expected ) );
+                return false;
+            }
+        }
+        return true;
+    }
+
+    TArray<uint8> MakeKernelTestOutput( int32 InSize )
+    {
+        TArray<uint8> output;
+        output.Init( KERNEL_TEST_GUARD, InSize + 64 );
+        return output;
+    }
+
+    FColor MakeKernelTestPixel( int32 InIndex )
+    {
+        return FColor( (uint8)(0x10 + InIndex), (uint8)(0x80 + InIndex), (uint8)(0xC0 - InIndex), (uint8)(0xF0 - InIndex) );
+    }
+
+    FFloat16 MakeKernelTestHalf( uint16 InBits )
+    {
+        FFloat16 half;
+        half.Encoded = InBits;
+        return half;
+    }
+
+    FFloat16Color MakeKernelTestHalfPixel( uint16 InR, uint16 InG, uint16 InB, uint16 InA )
+    {
+        FFloat16Color pixel;
+        pixel.R = MakeKernelTestHalf( InR );
+        pixel.G = MakeKernelTestHalf( InG );
+        pixel.B = MakeKernelTestHalf( InB );
+        pixel.A = MakeKernelTestHalf( InA );
+        return pixel;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FSCIPixelKernelsBgraToRgbaTest, "SCI.PixelKernels.BgraToRgba", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter )
+
+bool FSCIPixelKernelsBgraToRgbaTest::RunTest( const FString& Parameters )
+{
+    auto isPassed = true;
+    for ( const auto count : SCI::KERNEL_TEST_COUNTS ) {
+        TArray<FColor> pixels;
+        TArray<uint8> expected;
+        for ( int32 i = 0; i < count; i++ ) {
+            const auto pixel = SCI::MakeKernelTestPixel( i );
+            pixels.Add( pixel );
+            expected.Append( { pixel.R, pixel.G, pixel.B, pixel.A } );
+        }
+
+        auto output = SCI::MakeKernelTestOutput( count * 4 );
+        FSCIPixelKernels::BgraToRgba( pixels.GetData(), count, output.GetData() );
+        isPassed &= SCI::TestKernelBytes( *this, TEXT( "BgraToRgba" ), count, output, expected );
+    }
+    return isPassed;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FSCIPixelKernelsBgraToRgbTest, "SCI.PixelKernels.BgraToRgb", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter )
+
+bool FSCIPixelKernelsBgraToRgbTest::RunTest( const FString& Parameters )
+{
+    // The SSE path stores 16 bytes per 12 it produces, the guard bytes catch an overrun.
+    auto isPassed = true;
+    for ( const auto count : SCI::KERNEL_TEST_COUNTS ) {
+        TArray<FColor> pixels;
+        TArray<uint8> expected;
+        for ( int32 i = 0; i < count; i++ ) {
+            const auto pixel = SCI::MakeKernelTestPixel( i );
+            pixels.Add( pixel );
+            expected.Append( { pixel.R, pixel.G, pixel.B } );
+        }
+
+        auto output = SCI::MakeKernelTestOutput( count * 3 );
+        FSCIPixelKernels::BgraToRgb( pixels.GetData(), count, output.GetData() );
+        isPassed &= SCI::TestKernelBytes( *this, TEXT( "BgraToRgb" ), count, output, expected );
+    }
+    return isPassed;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FSCIPixelKernelsHalfToFloatTest, "SCI.PixelKernels.HalfToFloat", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter )
+
+bool FSCIPixelKernelsHalfToFloatTest::RunTest( const FString& Parameters )
+{
+    struct FCase
+    {
+        uint16 Half;
+        float Expected;
+    };
+    static const FCase CASES[] = {
+        { 0x0000, 0.0f },
+        { 0x8000, -0.0f },
+        { 0x3C00, 1.0f },
+        { 0xC000, -2.0f },
+        { 0x3555, 0.333251953125f },
+        { 0x7BFF, 65504.0f },
+        // Smallest and largest subnormal.
+        { 0x0001, 5.9604644775390625e-8f },
+        { 0x03FF, 6.097555160522461e-5f },
+        { 0x7C00, INFINITY },
+        { 0xFC00, -INFINITY },
+        { 0x7E00, NAN }
+    };
+
+    auto isPassed = true;
+    for ( const auto count : SCI::KERNEL_TEST_COUNTS ) {
+        TArray<FFloat16> halves;
+        for ( int32 i = 0; i < count; i++ )
+            halves.Add( SCI::MakeKernelTestHalf( CASES[ i % UE_ARRAY_COUNT( CASES ) ].Half ) );
+
+        TArray<float> output;
+        output.SetNumZeroed( count );
+        FSCIPixelKernels::HalfToFloat( halves.GetData(), count, output.GetData() );
+        for ( int32 i = 0; i < count; i++ ) {
+            const auto& testCase = CASES[ i % UE_ARRAY_COUNT( CASES ) ];
+            const auto isMatched = FMath::IsNaN( testCase.Expected )
+            ? FMath::IsNaN( output[ i ] )
+            : (FMemory::Memcmp( &output[ i ], &testCase.Expected, sizeof( float ) ) == 0);
+            if ( !isMatched ) {
+                AddError( FString::Printf( TEXT( "HalfToFloat (%d halves): 0x%04X gave %g, expected %g" ), count, testCase.Half, output[ i ], testCase.Expected ) );
+                isPassed = false;
+                break;
+            }
+        }
+    }
+    return isPassed;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FSCIPixelKernelsLinearToSrgb8Test, "SCI.PixelKernels.LinearToSrgb8", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter )
+
+bool FSCIPixelKernelsLinearToSrgb8Test::RunTest( const FString& Parameters )
+{
+    struct FCase
+    {
+        float Value;
+        uint8 Expected;
+    };
+    // Out of range values and NaN clamp, the rest are sRGB of the value times 255, rounded.
+    static const FCase CASES[] = {
+        { 0.0f, 0 },
+        { -1.0f, 0 },
+        { NAN, 0 },
+        { 1.0f, 255 },
+        { 2.0f, 255 },
+        { 0.5f, 188 },
+        { 0.18f, 118 },
+        { 0.75f, 225 },
+        { 0.01f, 25 },
+        { 0.0031308f, 10 }
+    };
+
+    auto isPassed = true;
+    for ( const auto count : SCI::KERNEL_TEST_COUNTS ) {
+        TArray<float> values;
+        TArray<uint8> expected;
+        for ( int32 i = 0; i < count; i++ ) {
+            const auto& testCase = CASES[ i % UE_ARRAY_COUNT( CASES ) ];
+            values.Add( testCase.Value );
+            expected.Add( testCase.Expected );
+        }
+
+        auto output = SCI::MakeKernelTestOutput( count );
+        FSCIPixelKernels::LinearToSrgb8( values.GetData(), count, output.GetData() );
+        isPassed &= SCI::TestKernelBytes( *this, TEXT( "LinearToSrgb8" ), count, output, expected );
+    }
+    return isPassed;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FSCIPixelKernelsBoxDownsample8Test, "SCI.PixelKernels.BoxDownsample2x8", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter )
+
+bool FSCIPixelKernelsBoxDownsample8Test::RunTest( const FString& Parameters )
+{
+    // Top left, top right, bottom left, bottom right, and the rounded average.
+    static const FColor BLOCKS[][ 5 ] = {
+        { FColor( 0, 0, 0, 0 ), FColor( 0, 0, 0, 0 ), FColor( 0, 0, 0, 0 ), FColor( 1, 2, 3, 255 ), FColor( 0, 1, 1, 64 ) },
+        { FColor( 255, 255, 255, 255 ), FColor( 255, 255, 255, 255 ), FColor( 255, 255, 255, 255 ), FColor( 255, 255, 255, 255 ), FColor( 255, 255, 255, 255 ) },
+        { FColor( 10, 20, 30, 40 ), FColor( 11, 21, 31, 41 ), FColor( 12, 22, 32, 42 ), FColor( 13, 23, 33, 43 ), FColor( 12, 22, 32, 42 ) },
+        { FColor( 0, 255, 0, 255 ), FColor( 255, 0, 255, 0 ), FColor( 0, 255, 0, 255 ), FColor( 255, 0, 255, 0 ), FColor( 128, 128, 128, 128 ) }
+    };
+
+    auto isPassed = true;
+    for ( const auto count : SCI::KERNEL_TEST_COUNTS ) {
+        TArray<FColor> row0;
+        TArray<FColor> row1;
+        TArray<uint8> expected;
+        for ( int32 i = 0; i < count; i++ ) {
+            const auto block = BLOCKS[ i % UE_ARRAY_COUNT( BLOCKS ) ];
+            row0.Append( { block[ 0 ], block[ 1 ] } );
+            row1.Append( { block[ 2 ], block[ 3 ] } );
+            expected.Append( reinterpret_cast<const uint8*>( &block[ 4 ] ), sizeof( FColor ) );
+        }
+
+        auto output = SCI::MakeKernelTestOutput( count * sizeof( FColor ) );
+        FSCIPixelKernels::BoxDownsample2x( row0.GetData(), row1.GetData(), count, reinterpret_cast<FColor*>( output.GetData() ) );
+        isPassed &= SCI::TestKernelBytes( *this, TEXT( "BoxDownsample2x (8-bit)" ), count, output, expected );
+    }
+    return isPassed;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FSCIPixelKernelsBoxDownsampleHalfTest, "SCI.PixelKernels.BoxDownsample2xHalf", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter )
+
+bool FSCIPixelKernelsBoxDownsampleHalfTest::RunTest( const FString& Parameters )
+{
+    // Four half inputs and their average. 65504 only survives when the sum is taken in float.
+    static const uint16 BLOCKS[][ 5 ] = {
+        { 0x3C00, 0x4000, 0x4200, 0x4400, 0x4100 },  // 1, 2, 3, 4 -> 2.5
+        { 0x3800, 0x3800, 0x3800, 0x3800, 0x3800 },  // 0.5
+        { 0x7BFF, 0x7BFF, 0x7BFF, 0x7BFF, 0x7BFF },  // 65504
+        { 0x7C00, 0x3C00, 0x3C00, 0x3C00, 0x7C00 },  // inf, 1, 1, 1 -> inf
+        { 0xBC00, 0x3C00, 0xC000, 0x4000, 0x0000 }   // -1, 1, -2, 2 -> 0
+    };
+    const auto blockCount = (int32)UE_ARRAY_COUNT( BLOCKS );
+
+    auto isPassed = true;
+    for ( const auto count : SCI::KERNEL_TEST_COUNTS ) {
+        // Every channel takes a different block, so a channel mix-up shows.
+        TArray<FFloat16Color> row0;
+        TArray<FFloat16Color> row1;
+        TArray<uint8> expected;
+        for ( int32 i = 0; i < count; i++ ) {
+            const uint16* blocks[ 4 ] = { BLOCKS[ i % blockCount ], BLOCKS[ (i + 1) % blockCount ], BLOCKS[ (i + 2) % blockCount ], BLOCKS[ (i + 3) % blockCount ] };
+            for ( int32 corner = 0; corner < 4; corner++ ) {
+                auto& row = corner < 2 ? row0 : row1;
+                row.Add( SCI::MakeKernelTestHalfPixel( blocks[ 0 ][ corner ], blocks[ 1 ][ corner ], blocks[ 2 ][ corner ], blocks[ 3 ][ corner ] ) );
+            }
+
+            const auto average = SCI::MakeKernelTestHalfPixel( blocks[ 0 ][ 4 ], blocks[ 1 ][ 4 ], blocks[ 2 ][ 4 ], blocks[ 3 ][ 4 ] );
+            expected.Append( reinterpret_cast<const uint8*>( &average ), sizeof( FFloat16Color ) );
+        }
+
+        auto output = SCI::MakeKernelTestOutput( count * sizeof( FFloat16Color ) );
+        FSCIPixelKernels::BoxDownsample2x( row0.GetData(), row1.GetData(), count, reinterpret_cast<FFloat16Color*>( output.GetData() ) );
+        isPassed &= SCI::TestKernelBytes( *this, TEXT( "BoxDownsample2x (half)" ), count, output, expected );
+    }
+    return isPassed;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FSCIPixelKernelsHalfToSrgb16Test, "SCI.PixelKernels.HalfToSrgb16BigEndian", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter )
+
+bool FSCIPixelKernelsHalfToSrgb16Test::RunTest( const FString& Parameters )
+{
+    // Color is sRGB encoded and clamped, NaN goes to zero, alpha stays linear; samples are big-endian.
+    // Three pixels, so the vector paths see every pixel in either half of a step.
+    const FFloat16Color PIXELS[] = {
+        SCI::MakeKernelTestHalfPixel( 0x0000, 0x3C00, 0x3800, 0x3800 ),  // 0, 1, 0.5, 0.5
+        SCI::MakeKernelTestHalfPixel( 0xBC00, 0x7E00, 0x4000, 0x3400 ),  // -1, NaN, 2, 0.25
+        SCI::MakeKernelTestHalfPixel( 0x7C00, 0x31C3, 0x0001, 0x3555 )   // inf, 0.18, smallest subnormal, 1/3
+    };
+    static const uint8 EXPECTED[][ 8 ] = {
+        { 0x00, 0x00, 0xFF, 0xFF, 0xBC, 0x40, 0x80, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x40, 0x00 },
+        { 0xFF, 0xFF, 0x76, 0x1F, 0x00, 0x00, 0x55, 0x50 }
+    };
+    const auto pixelCount = (int32)UE_ARRAY_COUNT( PIXELS );
+
+    auto isPassed = true;
+    for ( const auto count : SCI::KERNEL_TEST_COUNTS ) {
+        TArray<FFloat16Color> pixels;
+        TArray<uint8> expected;
+        for ( int32 i = 0; i < count; i++ ) {
+            pixels.Add( PIXELS[ i % pixelCount ] );
+            expected.Append( EXPECTED[ i % pixelCount ], 8 );
+        }
+
+        auto output = SCI::MakeKernelTestOutput( count * 8 );
+        FSCIPixelKernels::HalfToSrgb16BigEndian( pixels.GetData(), count, reinterpret_cast<uint16*>( output.GetData() ) );
+        isPassed &= SCI::TestKernelBytes( *this, TEXT( "HalfToSrgb16BigEndian" ), count, output, expected );
+    }
+    return isPassed;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FSCIPixelKernelsTonemapToSrgb8Test, "SCI.PixelKernels.TonemapToSrgb8", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter )
+
+bool FSCIPixelKernelsTonemapToSrgb8Test::RunTest( const FString& Parameters )
+{
+    // Exposure 2, so 0.25 and 0.09 land on 0.5 and about 0.18. Alpha is always opaque.
+    const FFloat16Color PIXELS[] = {
+        SCI::MakeKernelTestHalfPixel( 0x3400, 0x2DC3, 0x0000, 0x34CD ),  // 0.25, 0.09, 0, 0.3
+        SCI::MakeKernelTestHalfPixel( 0x3C00, 0xBC00, 0x1D1F, 0x0000 )   // 1, -1, 0.005, 0
+    };
+    static const FColor EXPECTED[] = {
+        FColor( 188, 118, 0, 255 ),
+        FColor( 255, 0, 25, 255 )
+    };
+
+    auto isPassed = true;
+    for ( const auto count : SCI::KERNEL_TEST_COUNTS ) {
+        TArray<FFloat16Color> pixels;
+        TArray<uint8> expected;
+        for ( int32 i = 0; i < count; i++ ) {
+            pixels.Add( PIXELS[ i % 2 ] );
+            expected.Append( reinterpret_cast<const uint8*>( &EXPECTED[ i % 2 ] ), sizeof( FColor ) );
+        }
+
+        auto output = SCI::MakeKernelTestOutput( count * sizeof( FColor ) );
+        FSCIPixelKernels::TonemapToSrgb8( pixels.GetData(), count, 2.0f, reinterpret_cast<FColor*>( output.GetData() ) );
+        isPassed &= SCI::TestKernelBytes( *this, TEXT( "TonemapToSrgb8" ), count, output, expected );
+    }
+    return isPassed;
+}
+
+#endif
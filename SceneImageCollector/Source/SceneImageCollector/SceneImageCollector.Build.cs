@@ -1,5 +1,6 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
+using System.IO;
 using UnrealBuildTool;
 
 public class SceneImageCollector : ModuleRules
@@ -12,7 +13,28 @@ public class SceneImageCollector : ModuleRules
         , "ImageWrapper", "RenderCore", "Renderer", "RHI"
         , "CinematicCamera" });
 
-		PrivateDependencyModuleNames.AddRange(new string[] {});
+		PrivateDependencyModuleNames.AddRange(new string[] { "Json" });
+
+        AddEngineThirdPartyPrivateStaticDependencies( Target, "zlib" );
+
+        // The parallel jpeg encoder compresses its strips with the engine's libjpeg-turbo where it ships.
+        if ( Target.Platform == UnrealTargetPlatform.Win64 || Target.Platform == UnrealTargetPlatform.Linux || Target.Platform == UnrealTargetPlatform.Mac ) {
+            AddEngineThirdPartyPrivateStaticDependencies( Target, "LibJpegTurbo" );
+            PrivateDefinitions.Add( "WITH_SCI_LIBJPEGTURBO=1" );
+        }
+        else {
+            PrivateDefinitions.Add( "WITH_SCI_LIBJPEGTURBO=0" );
+        }
+
+        // Compressed raw frames use zstd from Source/ThirdParty/Zstd when it has been dropped in,
+        // otherwise RAWZ is refused at BeginPlay.
+        if ( Zstd.IsAvailable( Path.Combine( ModuleDirectory, "..", "ThirdParty", "Zstd" ), Target ) ) {
+            PrivateDependencyModuleNames.Add( "Zstd" );
+            PrivateDefinitions.Add( "WITH_SCI_ZSTD=1" );
+        }
+        else {
+            PrivateDefinitions.Add( "WITH_SCI_ZSTD=0" );
+        }
 
         if ( Target.bBuildEditor ) {
             PrivateDependencyModuleNames.AddRange( 
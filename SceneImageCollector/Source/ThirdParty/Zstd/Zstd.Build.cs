@@ -0,0 +1,48 @@
+// Copyright Devcoder.
+
+using System.IO;
+using UnrealBuildTool;
+
+// zstd 1.5, built as a static library with ZSTD_MULTITHREAD so a frame can be compressed by
+// several zstd workers (the default cmake and make builds do that). Nothing is checked in, the
+// files are dropped in per machine:
+//
+//   include/               zstd.h, zdict.h and zstd_errors.h from zstd's lib directory
+//   lib/Win64/             zstd_static.lib
+//   lib/Linux, lib/Mac/    libzstd.a
+//
+// Without them the module stays empty and the game module builds without RAWZ.
+public class Zstd : ModuleRules
+{
+    // Null on platforms zstd is not prebuilt for.
+    public static string GetLibraryPath( string InModuleDirectory, ReadOnlyTargetRules Target )
+    {
+        var libraryDirectory = Path.Combine( InModuleDirectory, "lib", Target.Platform.ToString() );
+        if ( Target.Platform == UnrealTargetPlatform.Win64 ) {
+            return Path.Combine( libraryDirectory, "zstd_static.lib" );
+        }
+        if ( Target.Platform == UnrealTargetPlatform.Linux || Target.Platform == UnrealTargetPlatform.Mac ) {
+            return Path.Combine( libraryDirectory, "libzstd.a" );
+        }
+        return null;
+    }
+
+    // True when the headers and the library for the target platform are in place.
+    public static bool IsAvailable( string InModuleDirectory, ReadOnlyTargetRules Target )
+    {
+        var libraryPath = GetLibraryPath( InModuleDirectory, Target );
+        var includePath = Path.Combine( InModuleDirectory, "include" );
+        return libraryPath != null && File.Exists( libraryPath )
+        && File.Exists( Path.Combine( includePath, "zstd.h" ) ) && File.Exists( Path.Combine( includePath, "zdict.h" ) );
+    }
+
+    public Zstd( ReadOnlyTargetRules Target ) : base( Target )
+    {
+        Type = ModuleType.External;
+
+        if ( IsAvailable( ModuleDirectory, Target ) ) {
+            PublicSystemIncludePaths.Add( Path.Combine( ModuleDirectory, "include" ) );
+            PublicAdditionalLibraries.Add( GetLibraryPath( ModuleDirectory, Target ) );
+        }
+    }
+}